@@ -0,0 +1,13 @@
+# Embeddable engine: include engine.h and link against ppengine.
+# Static by default; "qmake CONFIG+=shared_engine" builds a shared library.
+TEMPLATE = lib
+TARGET = ppengine
+CONFIG -= qt
+CONFIG += c++11 staticlib
+
+shared_engine {
+    CONFIG -= staticlib
+    CONFIG += shared
+}
+
+include(engine.pri)
@@ -3,15 +3,10 @@ CONFIG += console
 CONFIG -= qt
 CONFIG += c++11
 
-SOURCES += main.cpp \
-    lexer.cpp \
-    parser.cpp
+include(engine.pri)
 
-HEADERS += \
-    lexer.h \
-    ast.h \
-    token.h \
-    parser.h \
-    programContext.h \
-    visitor.h
+SOURCES += main.cpp \
+    stats.cpp \
+    allocationCounter.cpp
 
+HEADERS += stats.h
@@ -7,7 +7,7 @@ using std::string;
 
 struct Token{
     enum Type{
-        LP, RP, COL, COM,
+        LP, RP, LB, RB, COL, COM,
         ASGN, EQ, NE, GE, LE, GT, LT,
         PLUS, MINUS, MULT, DIV,
         DEF, RET, END, WHILE, IF, PRINT, READ,
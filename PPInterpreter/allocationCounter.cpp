@@ -0,0 +1,52 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "stats.h"
+
+// Replaces the global allocation functions of the interpreter binary so
+// --stats can report heap traffic per phase. Kept out of the engine
+// library so embedding applications keep their own allocator. Runs
+// without --stats pay one relaxed load per allocation.
+static std::atomic<bool> counting(false);
+static std::atomic<long long> bytesAllocated(0);
+static std::atomic<long long> allocationsMade(0);
+
+void countAllocations(){
+    counting.store(true, std::memory_order_relaxed);
+}
+
+long long allocatedBytes(){
+    return bytesAllocated.load(std::memory_order_relaxed);
+}
+
+long long allocationCount(){
+    return allocationsMade.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size){
+    if (counting.load(std::memory_order_relaxed)) {
+        bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+        allocationsMade.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Like the standard operator new, gives the new handler a chance to
+    // free memory before each retry.
+    for (;;) {
+        void *p = malloc(size ? size : 1);
+        if (p) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *operator new[](size_t size){
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept{
+    free(p);
+}
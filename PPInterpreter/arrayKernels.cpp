@@ -0,0 +1,63 @@
+#include <cstring>
+#include "arrayKernels.h"
+
+#ifdef __GNUC__
+// Four lanes of unsigned arithmetic. GCC and Clang lower this to SSE2 or
+// NEON, and unsigned lanes wrap like the scalar operators.
+typedef unsigned Lanes __attribute__((vector_size(16)));
+static size_t const laneCount = sizeof(Lanes) / sizeof(unsigned);
+
+static inline Lanes load(int const *p){
+    Lanes v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store(int *p, Lanes v){
+    memcpy(p, &v, sizeof(v));
+}
+#endif
+
+int sumKernel(int const *data, size_t size){
+    size_t i = 0;
+    unsigned total = 0;
+#ifdef __GNUC__
+    Lanes lanes = {0, 0, 0, 0};
+    for (; i + laneCount <= size; i += laneCount)
+        lanes += load(data + i);
+    for (size_t lane = 0; lane != laneCount; ++lane)
+        total += lanes[lane];
+#endif
+    for (; i != size; ++i)
+        total += static_cast<unsigned>(data[i]);
+    return static_cast<int>(total);
+}
+
+void fillKernel(int *data, size_t size, int value){
+    for (size_t i = 0; i != size; ++i)
+        data[i] = value;
+}
+
+void copyKernel(int *dst, int const *src, size_t size){
+    if (size) memmove(dst, src, size * sizeof(int));
+}
+
+void addKernel(int *dst, int const *x, int const *y, size_t size){
+    size_t i = 0;
+#ifdef __GNUC__
+    for (; i + laneCount <= size; i += laneCount)
+        store(dst + i, load(x + i) + load(y + i));
+#endif
+    for (; i != size; ++i)
+        dst[i] = static_cast<int>(static_cast<unsigned>(x[i]) + static_cast<unsigned>(y[i]));
+}
+
+void mulKernel(int *dst, int const *x, int const *y, size_t size){
+    size_t i = 0;
+#ifdef __GNUC__
+    for (; i + laneCount <= size; i += laneCount)
+        store(dst + i, load(x + i) * load(y + i));
+#endif
+    for (; i != size; ++i)
+        dst[i] = static_cast<int>(static_cast<unsigned>(x[i]) * static_cast<unsigned>(y[i]));
+}
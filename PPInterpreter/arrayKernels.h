@@ -0,0 +1,15 @@
+#ifndef ARRAYKERNELS_H
+#define ARRAYKERNELS_H
+
+#include <cstddef>
+
+// Bulk loops behind the array built-ins. Arithmetic wraps around like the
+// scalar operators. dst may be the same array as an input, but arrays
+// never partially overlap.
+int sumKernel(int const *data, size_t size);
+void fillKernel(int *data, size_t size, int value);
+void copyKernel(int *dst, int const *src, size_t size);
+void addKernel(int *dst, int const *x, int const *y, size_t size);
+void mulKernel(int *dst, int const *x, int const *y, size_t size);
+
+#endif // ARRAYKERNELS_H
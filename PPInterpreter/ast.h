@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include <tr1/memory>
 #include "lexer.h"
 #include "visitor.h"
@@ -12,27 +14,64 @@ using std::vector;
 using std::tr1::shared_ptr;
 
 struct Instruction;
+struct Bytecode;
+struct LoopIdiom;
 
 typedef shared_ptr<Instruction> InstructionPtr;
 typedef vector<InstructionPtr> Instructions;
 
+// Profile and optimized code of a def or while body. Execution counts
+// hotness and the tiering thread publishes code, so every field may be
+// touched from several threads.
+struct TierSlot {
+    enum State{
+        COLD, QUEUED, COMPILED, FAILED
+    };
+
+    std::atomic<unsigned> hotness;
+    std::atomic<int> state;
+    std::atomic<Bytecode const *> code;
+    shared_ptr<Bytecode const> owner;
+
+    TierSlot():
+        hotness(0),
+        state(COLD),
+        code(0)
+    {}
+};
+
 struct Instruction {
-    Instruction(size_t lineNumber) : lineNumber(lineNumber) {}
+    enum Kind{
+        PROGRAM, FUN_DEF, VAR_DEF, NUM, VAR, FUN_CALL, OPERATOR,
+        COND, IF, WHILE, RETURN, READ, PRINT,
+        INDEX, INDEX_ASSIGN, ARRAY_OP, INLINED_CALL
+    };
+
+    Instruction(Kind kind, size_t lineNumber):
+        lineNumber(lineNumber),
+        kind(kind)
+    {}
     virtual ~Instruction() {}
 
     size_t getLineNumber() const{
         return lineNumber;
     }
 
+    // Tag used by StaticVisitor to dispatch with a switch instead of accept().
+    Kind getKind() const{
+        return static_cast<Kind>(kind);
+    }
+
     virtual int accept(Visitor &) = 0;
 
 private:
     size_t lineNumber;
+    unsigned char kind;
 };
 
 struct InstructionList: public Instruction {
-    InstructionList(Instructions const &instructions, size_t lineNumber):
-        Instruction(lineNumber),
+    InstructionList(Kind kind, Instructions const &instructions, size_t lineNumber):
+        Instruction(kind, lineNumber),
         instructions(instructions)
     {}
 
@@ -46,7 +85,7 @@ private:
 
 struct Program: public InstructionList {
     Program(Instructions const &instructions, size_t lineNumber):
-        InstructionList(instructions, lineNumber)
+        InstructionList(PROGRAM, instructions, lineNumber)
     {}
 
     int accept(Visitor &v){
@@ -54,11 +93,28 @@ struct Program: public InstructionList {
     }
 };
 
+// Source of a def body that has not been parsed yet.
+struct LazyBody {
+    virtual ~LazyBody() {}
+    virtual Instructions parse() const = 0;
+};
+
+typedef shared_ptr<LazyBody> LazyBodyPtr;
+
 struct FunDef: public InstructionList {
     FunDef(string const &name, vector<string> const &params, Instructions const &instructions, size_t lineNumber):
-        InstructionList(instructions, lineNumber),
+        InstructionList(FUN_DEF, instructions, lineNumber),
         name(name),
-        params(params)
+        params(params),
+        parsed(true)
+    {}
+
+    FunDef(string const &name, vector<string> const &params, LazyBodyPtr const &lazyBody, size_t lineNumber):
+        InstructionList(FUN_DEF, Instructions(), lineNumber),
+        name(name),
+        params(params),
+        lazyBody(lazyBody),
+        parsed(false)
     {}
 
     string const &getName() const{
@@ -69,6 +125,21 @@ struct FunDef: public InstructionList {
         return params;
     }
 
+    // Hides InstructionList::getInstructions() so that a lazy body is
+    // parsed on first use. Safe to call from several threads.
+    Instructions const &getInstructions() const{
+        if (!parsed.load(std::memory_order_acquire)) parseBody();
+        return lazyBody ? body : InstructionList::getInstructions();
+    }
+
+    bool isParsed() const{
+        return parsed.load(std::memory_order_acquire);
+    }
+
+    TierSlot &getTier() const{
+        return tier;
+    }
+
     int accept(Visitor &v){
         return v.visit(*this);
     }
@@ -76,11 +147,26 @@ struct FunDef: public InstructionList {
 private:
     string name;
     vector<string> params;
+
+    LazyBodyPtr lazyBody;
+    mutable Instructions body;
+    mutable std::once_flag parseOnce;
+    mutable std::atomic<bool> parsed;
+    mutable TierSlot tier;
+
+    void parseBody() const{
+        std::call_once(parseOnce, &FunDef::loadBody, this);
+    }
+
+    void loadBody() const{
+        body = lazyBody->parse();
+        parsed.store(true, std::memory_order_release);
+    }
 };
 
 struct VarDef: public Instruction {
     VarDef(string const &name, InstructionPtr exp, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(VAR_DEF, lineNumber),
         name(name),
         exp(exp)
     {}
@@ -89,7 +175,7 @@ struct VarDef: public Instruction {
         return name;
     }
 
-    InstructionPtr getExp() const{
+    InstructionPtr const &getExp() const{
         return exp;
     }
 
@@ -104,7 +190,7 @@ private:
 
 struct Num: public Instruction {
     Num(int value, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(NUM, lineNumber),
         value(value)
     {}
 
@@ -122,7 +208,7 @@ private:
 
 struct Var: public Instruction {
     Var(string const &name, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(VAR, lineNumber),
         name(name)
     {}
 
@@ -140,7 +226,7 @@ private:
 
 struct FunCall: public Instruction {
     FunCall(string const &name, Instructions const &params, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(FUN_CALL, lineNumber),
         name(name),
         params(params)
     {}
@@ -164,7 +250,7 @@ private:
 
 struct Operator: public Instruction {
     Operator(const char op, InstructionPtr left, InstructionPtr right, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(OPERATOR, lineNumber),
         operation(op),
         left(left),
         right(right)
@@ -174,11 +260,11 @@ struct Operator: public Instruction {
         return operation;
     }
 
-    InstructionPtr getLeft() const{
+    InstructionPtr const &getLeft() const{
         return left;
     }
 
-    InstructionPtr getRight() const{
+    InstructionPtr const &getRight() const{
         return right;
     }
 
@@ -194,7 +280,7 @@ private:
 
 struct Read: public Instruction {
     Read(string const &var, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(READ, lineNumber),
         var(var)
     {}
 
@@ -212,11 +298,11 @@ private:
 
 struct Print: public Instruction {
     Print(InstructionPtr exp, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(PRINT, lineNumber),
         exp(exp)
     {}
 
-    InstructionPtr getExp() const{
+    InstructionPtr const &getExp() const{
         return exp;
     }
 
@@ -230,21 +316,21 @@ private:
 
 struct Cond: public Instruction {
     Cond(InstructionPtr left, InstructionPtr right, string comp, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(COND, lineNumber),
         left(left),
         right(right),
         comparison(comp)
     {}
 
-    string getComparison() const{
+    string const &getComparison() const{
         return comparison;
     }
 
-    InstructionPtr getLeft() const{
+    InstructionPtr const &getLeft() const{
         return left;
     }
 
-    InstructionPtr getRight() const{
+    InstructionPtr const &getRight() const{
         return right;
     }
 
@@ -260,11 +346,11 @@ private:
 
 struct If: public InstructionList {
     If(InstructionPtr cond, Instructions const &instructions, size_t lineNumber):
-        InstructionList(instructions, lineNumber),
+        InstructionList(IF, instructions, lineNumber),
         cond(cond)
     {}
 
-    InstructionPtr getCond() const{
+    InstructionPtr const &getCond() const{
         return cond;
     }
 
@@ -278,29 +364,96 @@ private:
 
 struct While: public InstructionList {
     While(InstructionPtr cond, Instructions const &instructions, size_t lineNumber):
-        InstructionList(instructions, lineNumber),
+        InstructionList(WHILE, instructions, lineNumber),
         cond(cond)
     {}
 
-    InstructionPtr getCond() const{
+    InstructionPtr const &getCond() const{
         return cond;
     }
 
+    TierSlot &getTier() const{
+        return tier;
+    }
+
+    // Set by recognizeLoopIdioms() before the program runs.
+    LoopIdiom const *getIdiom() const{
+        return idiom.get();
+    }
+
+    void setIdiom(shared_ptr<LoopIdiom const> const &idiom){
+        this->idiom = idiom;
+    }
+
     int accept(Visitor &v){
         return v.visit(*this);
     }
 
 private:
     InstructionPtr cond;
+    mutable TierSlot tier;
+    shared_ptr<LoopIdiom const> idiom;
 };
 
 struct Return: public Instruction {
     Return(InstructionPtr exp, size_t lineNumber):
-        Instruction(lineNumber),
+        Instruction(RETURN, lineNumber),
+        exp(exp)
+    {}
+
+    InstructionPtr const &getExp() const{
+        return exp;
+    }
+
+    int accept(Visitor &v){
+        return v.visit(*this);
+    }
+
+private:
+    InstructionPtr exp;
+};
+
+struct Index: public Instruction {
+    Index(string const &name, InstructionPtr index, size_t lineNumber):
+        Instruction(INDEX, lineNumber),
+        name(name),
+        index(index)
+    {}
+
+    string const &getName() const{
+        return name;
+    }
+
+    InstructionPtr const &getIndex() const{
+        return index;
+    }
+
+    int accept(Visitor &v){
+        return v.visit(*this);
+    }
+
+private:
+    string name;
+    InstructionPtr index;
+};
+
+struct IndexAssign: public Instruction {
+    IndexAssign(string const &name, InstructionPtr index, InstructionPtr exp, size_t lineNumber):
+        Instruction(INDEX_ASSIGN, lineNumber),
+        name(name),
+        index(index),
         exp(exp)
     {}
 
-    InstructionPtr getExp() const{
+    string const &getName() const{
+        return name;
+    }
+
+    InstructionPtr const &getIndex() const{
+        return index;
+    }
+
+    InstructionPtr const &getExp() const{
         return exp;
     }
 
@@ -309,7 +462,104 @@ struct Return: public Instruction {
     }
 
 private:
+    string name;
+    InstructionPtr index;
     InstructionPtr exp;
 };
 
+// Built-in array functions. Arrays are int handles into the heap of the
+// running ExecutionContext.
+struct ArrayOp: public Instruction {
+    enum Operation{
+        NEW, LEN, SUM, FILL, COPY, ADD, MUL
+    };
+
+    ArrayOp(Operation op, Instructions const &params, size_t lineNumber):
+        Instruction(ARRAY_OP, lineNumber),
+        operation(op),
+        params(params)
+    {}
+
+    Operation getOperation() const{
+        return operation;
+    }
+
+    Instructions const &getParams() const{
+        return params;
+    }
+
+    // Name as written in PP source and the number of arguments it takes.
+    static char const *name(Operation op);
+    static size_t arity(Operation op);
+    // Returns false if name is not a built-in.
+    static bool lookup(string const &name, Operation &op);
+
+    int accept(Visitor &v){
+        return v.visit(*this);
+    }
+
+private:
+    Operation operation;
+    Instructions params;
+};
+
+inline char const *ArrayOp::name(Operation op){
+    static char const *const names[] = {"array", "len", "sum", "fill", "copy", "vadd", "vmul"};
+    return names[op];
+}
+
+inline size_t ArrayOp::arity(Operation op){
+    static size_t const arities[] = {1, 1, 1, 2, 2, 3, 3};
+    return arities[op];
+}
+
+inline bool ArrayOp::lookup(string const &name, Operation &op){
+    for (int i = NEW; i <= MUL; ++i) {
+        if (name == ArrayOp::name(static_cast<Operation>(i))) {
+            op = static_cast<Operation>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// A FunCall replaced by the body of its def (see inliner.h). The args
+// are evaluated in order into temporaries of the calling frame, named so
+// that PP source cannot refer to them, and then the body is evaluated.
+struct InlinedCall: public Instruction {
+    InlinedCall(string const &name, vector<string> const &temps, Instructions const &args, InstructionPtr body, size_t lineNumber):
+        Instruction(INLINED_CALL, lineNumber),
+        name(name),
+        temps(temps),
+        args(args),
+        body(body)
+    {}
+
+    string const &getName() const{
+        return name;
+    }
+
+    vector<string> const &getTemps() const{
+        return temps;
+    }
+
+    Instructions const &getArgs() const{
+        return args;
+    }
+
+    InstructionPtr const &getBody() const{
+        return body;
+    }
+
+    int accept(Visitor &v){
+        return v.visit(*this);
+    }
+
+private:
+    string name;
+    vector<string> temps;
+    Instructions args;
+    InstructionPtr body;
+};
+
 #endif // AST_H
@@ -0,0 +1,237 @@
+#include <map>
+#include "bytecode.h"
+#include "staticVisitor.h"
+
+using std::map;
+
+namespace {
+
+class BytecodeCompiler: public StaticVisitor<BytecodeCompiler, bool> {
+public:
+    BytecodeCompiler(ProgramContext const &program):
+        program(program),
+        bytecode(new Bytecode()),
+        root(0),
+        depth(0)
+    {
+        bytecode->maxStack = 0;
+        bytecode->paramCount = 0;
+    }
+
+    bool function(FunDef const &node){
+        vector<string> const &params = node.getParams();
+        for (size_t i = 0; i != params.size(); ++i)
+            slot(params[i]);
+        bytecode->paramCount = params.size();
+        if (!statements(node.getInstructions())) return false;
+        emit(Bytecode::END, 0, node.getLineNumber());
+        return true;
+    }
+
+    bool loop(While const &node){
+        root = &node;
+        if (!visit(node)) return false;
+        emit(Bytecode::END, 0, node.getLineNumber());
+        return true;
+    }
+
+    shared_ptr<Bytecode> result() const{
+        return bytecode;
+    }
+
+    bool visit(Program const &){ return false; }
+    bool visit(FunDef const &){ return false; }
+
+    bool visit(VarDef const &node){
+        if (!expression(node.getExp())) return false;
+        emit(Bytecode::STORE, slot(node.getName()), node.getLineNumber(), -1);
+        return true;
+    }
+
+    bool visit(Num const &node){
+        emit(Bytecode::CONST, node.getValue(), node.getLineNumber(), 1);
+        return true;
+    }
+
+    bool visit(Var const &node){
+        emit(Bytecode::LOAD, slot(node.getName()), node.getLineNumber(), 1);
+        return true;
+    }
+
+    bool visit(FunCall const &node){
+        // Unknown functions and wrong arities stay in the AST tier, which
+        // reports them before evaluating any argument.
+        map<string, FunPtr>::const_iterator it = program.functions.find(node.getName());
+        if (it == program.functions.end()) return false;
+        Instructions const &args = node.getParams();
+        if (it->second->getParams().size() != args.size()) return false;
+
+        for (size_t i = 0; i != args.size(); ++i)
+            if (!expression(args[i])) return false;
+
+        Bytecode::Call call;
+        call.function = it->second.get();
+        call.name = node.getName();
+        bytecode->calls.push_back(call);
+        emit(Bytecode::CALL, bytecode->calls.size() - 1, node.getLineNumber(), 1 - static_cast<int>(args.size()));
+        return true;
+    }
+
+    bool visit(Operator const &node){
+        if (!expression(node.getLeft()) || !expression(node.getRight())) return false;
+        switch (node.getOperation()) {
+        case '+': emit(Bytecode::ADD, 0, node.getLineNumber(), -1); return true;
+        case '-': emit(Bytecode::SUB, 0, node.getLineNumber(), -1); return true;
+        case '*': emit(Bytecode::MUL, 0, node.getLineNumber(), -1); return true;
+        case '/': emit(Bytecode::DIV, 0, node.getLineNumber(), -1); return true;
+        default: return false;
+        }
+    }
+
+    bool visit(Cond const &node){
+        if (!expression(node.getLeft()) || !expression(node.getRight())) return false;
+        string const &comparison = node.getComparison();
+        Bytecode::Op op;
+        if (comparison == "==") op = Bytecode::EQ;
+        else if (comparison == "!=") op = Bytecode::NE;
+        else if (comparison == "<") op = Bytecode::LT;
+        else if (comparison == ">") op = Bytecode::GT;
+        else if (comparison == "<=") op = Bytecode::LE;
+        else if (comparison == ">=") op = Bytecode::GE;
+        else return false;
+        emit(op, 0, node.getLineNumber(), -1);
+        return true;
+    }
+
+    bool visit(If const &node){
+        if (!expression(node.getCond())) return false;
+        size_t jump = emit(Bytecode::JUMP_IF_FALSE, 0, node.getLineNumber(), -1);
+        if (!statements(node.getInstructions())) return false;
+        bytecode->code[jump].arg = bytecode->code.size();
+        return true;
+    }
+
+    bool visit(While const &node){
+        // A nested loop with a recognized idiom stays in the AST tier,
+        // which runs it without iterating.
+        if (node.getIdiom() && &node != root) return false;
+        size_t head = bytecode->code.size();
+        if (!expression(node.getCond())) return false;
+        size_t jump = emit(Bytecode::JUMP_IF_FALSE, 0, node.getLineNumber(), -1);
+        if (!statements(node.getInstructions())) return false;
+        emit(Bytecode::LOOP, head, node.getLineNumber());
+        bytecode->code[jump].arg = bytecode->code.size();
+        return true;
+    }
+
+    bool visit(Return const &node){
+        if (!expression(node.getExp())) return false;
+        emit(Bytecode::RETURN, 0, node.getLineNumber(), -1);
+        return true;
+    }
+
+    bool visit(Read const &node){
+        emit(Bytecode::READ, slot(node.getVar()), node.getLineNumber());
+        return true;
+    }
+
+    bool visit(Print const &node){
+        if (!expression(node.getExp())) return false;
+        emit(Bytecode::PRINT, 0, node.getLineNumber(), -1);
+        return true;
+    }
+
+    bool visit(Index const &node){
+        emit(Bytecode::LOAD, slot(node.getName()), node.getLineNumber(), 1);
+        if (!expression(node.getIndex())) return false;
+        emit(Bytecode::INDEX, 0, node.getLineNumber(), -1);
+        return true;
+    }
+
+    bool visit(IndexAssign const &node){
+        emit(Bytecode::LOAD, slot(node.getName()), node.getLineNumber(), 1);
+        if (!expression(node.getIndex()) || !expression(node.getExp())) return false;
+        emit(Bytecode::INDEX_STORE, 0, node.getLineNumber(), -3);
+        return true;
+    }
+
+    bool visit(ArrayOp const &node){
+        Instructions const &params = node.getParams();
+        if (params.size() != ArrayOp::arity(node.getOperation())) return false;
+        for (size_t i = 0; i != params.size(); ++i)
+            if (!expression(params[i])) return false;
+        emit(Bytecode::ARRAY, node.getOperation(), node.getLineNumber(), 1 - static_cast<int>(params.size()));
+        return true;
+    }
+
+    bool visit(InlinedCall const &node){
+        vector<string> const &temps = node.getTemps();
+        Instructions const &args = node.getArgs();
+        for (size_t i = 0; i != args.size(); ++i) {
+            if (!expression(args[i])) return false;
+            emit(Bytecode::STORE, slot(temps[i]), node.getLineNumber(), -1);
+        }
+        return expression(node.getBody());
+    }
+
+private:
+    ProgramContext const &program;
+    shared_ptr<Bytecode> bytecode;
+    While const *root;
+    map<string, int> slots;
+    int depth;
+
+    size_t emit(Bytecode::Op op, int arg, size_t lineNumber, int stackEffect = 0){
+        depth += stackEffect;
+        if (depth > static_cast<int>(bytecode->maxStack)) bytecode->maxStack = depth;
+        bytecode->code.push_back(Bytecode::Instr(op, arg, lineNumber));
+        return bytecode->code.size() - 1;
+    }
+
+    int slot(string const &name){
+        map<string, int>::const_iterator it = slots.find(name);
+        if (it != slots.end()) return it->second;
+        bytecode->slots.push_back(name);
+        return slots[name] = bytecode->slots.size() - 1;
+    }
+
+    bool expression(InstructionPtr const &node){
+        return node && dispatch(node);
+    }
+
+    bool statements(Instructions const &instructions){
+        for (size_t i = 0; i != instructions.size(); ++i) {
+            InstructionPtr const &instruction = instructions[i];
+            if (!instruction || !dispatch(instruction)) return false;
+            switch (instruction->getKind()) {
+            case Instruction::NUM:
+            case Instruction::VAR:
+            case Instruction::FUN_CALL:
+            case Instruction::OPERATOR:
+            case Instruction::COND:
+            case Instruction::INDEX:
+            case Instruction::ARRAY_OP:
+            case Instruction::INLINED_CALL:
+                emit(Bytecode::POP, 0, instruction->getLineNumber(), -1);
+                break;
+            default:
+                break;
+            }
+        }
+        return true;
+    }
+};
+
+}
+
+BytecodePtr compileFunction(FunDef const &function, ProgramContext const &program){
+    BytecodeCompiler compiler(program);
+    if (!compiler.function(function)) return BytecodePtr();
+    return compiler.result();
+}
+
+BytecodePtr compileLoop(While const &loop, ProgramContext const &program){
+    BytecodeCompiler compiler(program);
+    if (!compiler.loop(loop)) return BytecodePtr();
+    return compiler.result();
+}
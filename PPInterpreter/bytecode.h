@@ -0,0 +1,62 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <string>
+#include <vector>
+#include <tr1/memory>
+#include "ast.h"
+#include "programContext.h"
+
+using std::string;
+using std::vector;
+using std::tr1::shared_ptr;
+
+// Optimized tier: a def or while body lowered to stack code. Variables
+// live in numbered slots instead of a map, and calls are resolved to
+// their FunDef when the code is compiled.
+struct Bytecode {
+    enum Op{
+        CONST, LOAD, STORE, POP,
+        ADD, SUB, MUL, DIV,
+        EQ, NE, LT, GT, LE, GE,
+        JUMP, JUMP_IF_FALSE, LOOP,
+        CALL, RETURN, READ, PRINT,
+        INDEX, INDEX_STORE, ARRAY, END
+    };
+
+    struct Instr {
+        unsigned char op;
+        int arg;
+        size_t lineNumber;
+
+        Instr(Op op, int arg, size_t lineNumber):
+            op(op),
+            arg(arg),
+            lineNumber(lineNumber)
+        {}
+    };
+
+    // Target of a CALL; arg of the instruction indexes this table.
+    struct Call {
+        FunDef const *function;
+        string name;
+    };
+
+    vector<Instr> code;
+    vector<string> slots;
+    vector<Call> calls;
+    size_t maxStack;
+    // Set for function code; parameters take the first slots in order.
+    size_t paramCount;
+};
+
+typedef shared_ptr<Bytecode const> BytecodePtr;
+
+// Both return null when the body uses something the optimized tier does
+// not handle; the interpreter then keeps running it in the AST tier.
+BytecodePtr compileFunction(FunDef const &function, ProgramContext const &program);
+// Loop code starts at the condition and stops with END when it fails, so
+// a running loop can enter it at a back-edge.
+BytecodePtr compileLoop(While const &loop, ProgramContext const &program);
+
+#endif // BYTECODE_H
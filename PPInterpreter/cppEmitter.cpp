@@ -0,0 +1,478 @@
+#include <climits>
+#include <set>
+#include <sstream>
+#include "cppEmitter.h"
+#include "staticVisitor.h"
+
+using std::set;
+using std::ostringstream;
+
+// Support code copied into every generated file. It mirrors the checks
+// and messages of ExecutionContext.
+static char const *const runtime =
+    "#include <climits>\n"
+    "#include <cstring>\n"
+    "#include <iostream>\n"
+    "#include <new>\n"
+    "#include <string>\n"
+    "#include <vector>\n"
+    "#include <stdint.h>\n"
+    "#ifndef _WIN32\n"
+    "#include <sys/resource.h>\n"
+    "#endif\n"
+    "\n"
+    "namespace pp {\n"
+    "\n"
+    "struct Error {\n"
+    "    std::string message;\n"
+    "    size_t line;\n"
+    "};\n"
+    "\n"
+    "static char const *stackLimit = 0;\n"
+    "static std::vector<std::vector<int> > arrays;\n"
+    "static size_t arrayElements = 0;\n"
+    "\n"
+    "static void fail(std::string const &message, size_t line){\n"
+    "    Error error = {message, line};\n"
+    "    throw error;\n"
+    "}\n"
+    "\n"
+    "struct Var {\n"
+    "    int value;\n"
+    "    bool defined;\n"
+    "\n"
+    "    Var(): value(0), defined(false) {}\n"
+    "\n"
+    "    int get(char const *name, size_t line) const{\n"
+    "        if (!defined) fail(std::string(\"undefined variable '\") + name + \"'\", line);\n"
+    "        return value;\n"
+    "    }\n"
+    "\n"
+    "    void set(int v){\n"
+    "        value = v;\n"
+    "        defined = true;\n"
+    "    }\n"
+    "};\n"
+    "\n"
+    "// The same limit as the interpreter's: RLIMIT_STACK below base, less an\n"
+    "// eighth in reserve, so that recursion fails at a depth set by the stack\n"
+    "// size rather than by a count of calls.\n"
+    "static void limitStack(char const *base){\n"
+    "    size_t size = 1 << 20;\n"
+    "#ifndef _WIN32\n"
+    "    size = 2 << 20;\n"
+    "    rlimit limit;\n"
+    "    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)\n"
+    "        size = limit.rlim_cur;\n"
+    "#endif\n"
+    "    uintptr_t usable = size - size / 8;\n"
+    "    uintptr_t address = reinterpret_cast<uintptr_t>(base);\n"
+    "    stackLimit = reinterpret_cast<char const *>(address > usable ? address - usable : 0);\n"
+    "}\n"
+    "\n"
+    "struct Call {\n"
+    "    Call(char const *, size_t line){\n"
+    "        char here;\n"
+    "        if (reinterpret_cast<uintptr_t>(&here) < reinterpret_cast<uintptr_t>(stackLimit))\n"
+    "            fail(\"call stack overflow\", line);\n"
+    "    }\n"
+    "};\n"
+    "\n"
+    "static inline int add(int l, int r){ return static_cast<int>(static_cast<unsigned>(l) + static_cast<unsigned>(r)); }\n"
+    "static inline int subtract(int l, int r){ return static_cast<int>(static_cast<unsigned>(l) - static_cast<unsigned>(r)); }\n"
+    "static inline int multiply(int l, int r){ return static_cast<int>(static_cast<unsigned>(l) * static_cast<unsigned>(r)); }\n"
+    "static inline int divide(int l, int r, size_t line){\n"
+    "    if (r == 0) fail(\"division by zero\", line);\n"
+    "    if (l == INT_MIN && r == -1) return INT_MIN;\n"
+    "    return l / r;\n"
+    "}\n"
+    "\n"
+    "static int read(char const *name, size_t line){\n"
+    "    int value = 0;\n"
+    "    if (!(std::cin >> value)) fail(std::string(\"no input for '\") + name + \"'\", line);\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "static void print(int value){\n"
+    "    std::cout << value << '\\n';\n"
+    "}\n"
+    "\n"
+    "static std::vector<int> &array(int handle, size_t line){\n"
+    "    if (handle <= 0 || static_cast<size_t>(handle) > arrays.size()) fail(\"value is not an array\", line);\n"
+    "    return arrays[handle - 1];\n"
+    "}\n"
+    "\n"
+    "static int load(int handle, int index, size_t line){\n"
+    "    std::vector<int> &a = array(handle, line);\n"
+    "    if (index < 0 || static_cast<size_t>(index) >= a.size()) fail(\"array index out of bounds\", line);\n"
+    "    return a[index];\n"
+    "}\n"
+    "\n"
+    "static void store(int handle, int index, int value, size_t line){\n"
+    "    std::vector<int> &a = array(handle, line);\n"
+    "    if (index < 0 || static_cast<size_t>(index) >= a.size()) fail(\"array index out of bounds\", line);\n"
+    "    a[index] = value;\n"
+    "}\n"
+    "\n"
+    "static int newArray(int size, size_t line){\n"
+    "    if (size < 0) fail(\"negative array size\", line);\n"
+    "    if (arrays.size() >= static_cast<size_t>(INT_MAX)) fail(\"too many arrays\", line);\n"
+    "    if (static_cast<size_t>(size) > (size_t(1) << 28) - arrayElements) fail(\"arrays too large\", line);\n"
+    "    try {\n"
+    "        arrays.push_back(std::vector<int>(size, 0));\n"
+    "    } catch (std::bad_alloc const &) {\n"
+    "        fail(\"out of memory\", line);\n"
+    "    }\n"
+    "    arrayElements += size;\n"
+    "    return arrays.size();\n"
+    "}\n"
+    "\n"
+    "static int len(int a, size_t line){\n"
+    "    return array(a, line).size();\n"
+    "}\n"
+    "\n"
+    "static int sum(int a, size_t line){\n"
+    "    std::vector<int> &v = array(a, line);\n"
+    "    unsigned total = 0;\n"
+    "    for (size_t i = 0; i != v.size(); ++i) total += static_cast<unsigned>(v[i]);\n"
+    "    return static_cast<int>(total);\n"
+    "}\n"
+    "\n"
+    "static int fill(int a, int value, size_t line){\n"
+    "    std::vector<int> &v = array(a, line);\n"
+    "    for (size_t i = 0; i != v.size(); ++i) v[i] = value;\n"
+    "    return a;\n"
+    "}\n"
+    "\n"
+    "static int copy(int dst, int src, size_t line){\n"
+    "    std::vector<int> &d = array(dst, line);\n"
+    "    std::vector<int> &s = array(src, line);\n"
+    "    if (s.size() != d.size()) fail(\"array lengths differ\", line);\n"
+    "    if (!d.empty()) memmove(&d[0], &s[0], d.size() * sizeof(int));\n"
+    "    return dst;\n"
+    "}\n"
+    "\n"
+    "static int vadd(int dst, int x, int y, size_t line){\n"
+    "    std::vector<int> &d = array(dst, line);\n"
+    "    std::vector<int> &a = array(x, line);\n"
+    "    std::vector<int> &b = array(y, line);\n"
+    "    if (a.size() != d.size() || b.size() != d.size()) fail(\"array lengths differ\", line);\n"
+    "    for (size_t i = 0; i != d.size(); ++i) d[i] = add(a[i], b[i]);\n"
+    "    return dst;\n"
+    "}\n"
+    "\n"
+    "static int vmul(int dst, int x, int y, size_t line){\n"
+    "    std::vector<int> &d = array(dst, line);\n"
+    "    std::vector<int> &a = array(x, line);\n"
+    "    std::vector<int> &b = array(y, line);\n"
+    "    if (a.size() != d.size() || b.size() != d.size()) fail(\"array lengths differ\", line);\n"
+    "    for (size_t i = 0; i != d.size(); ++i) d[i] = multiply(a[i], b[i]);\n"
+    "    return dst;\n"
+    "}\n"
+    "\n"
+    "}\n";
+
+static string quote(string const &text){
+    string res = "\"";
+    for (size_t i = 0; i != text.size(); ++i) {
+        char c = text[i];
+        if (c == '"' || c == '\\') res.push_back('\\');
+        if (c == '\n') {
+            res += "\\n";
+            continue;
+        }
+        res.push_back(c);
+    }
+    return res + "\"";
+}
+
+namespace {
+
+// Lowers one body. Expressions become a sequence of temporaries so that
+// C++ evaluates operands left to right, as the interpreter does.
+class CppEmitter: public StaticVisitor<CppEmitter, string> {
+public:
+    CppEmitter(ProgramContext const &program, string const &sourceName, bool topLevel):
+        program(program),
+        sourceName(sourceName),
+        topLevel(topLevel),
+        indent(1),
+        temps(0)
+    {}
+
+    void body(Instructions const &instructions){
+        for (size_t i = 0; i != instructions.size(); ++i)
+            statement(*instructions[i]);
+    }
+
+    // Declarations of every variable the body touched, minus the params.
+    string declarations(vector<string> const &params) const{
+        ostringstream res;
+        for (size_t i = 0; i != params.size(); ++i)
+            res << "    pp::Var v_" << params[i] << ";\n    v_" << params[i] << ".set(p_" << params[i] << ");\n";
+        for (set<string>::const_iterator it = variables.begin(); it != variables.end(); ++it) {
+            bool param = false;
+            for (size_t i = 0; i != params.size(); ++i)
+                if (params[i] == *it) param = true;
+            if (!param) res << "    pp::Var v_" << *it << ";\n";
+        }
+        return res.str();
+    }
+
+    string code() const{
+        return out.str();
+    }
+
+    string visit(Program const &){ return "0"; }
+    string visit(FunDef const &){ return "0"; }
+
+    string visit(VarDef const &node){
+        string value = dispatch(node.getExp());
+        line() << variable(node.getName()) << ".set(" << value << ");\n";
+        return value;
+    }
+
+    string visit(Num const &node){
+        if (node.getValue() == INT_MIN) return "INT_MIN";
+        ostringstream res;
+        res << node.getValue();
+        return res.str();
+    }
+
+    string visit(Var const &node){
+        return temp(get(node.getName(), node.getLineNumber()));
+    }
+
+    string visit(FunCall const &node){
+        map<string, FunPtr>::const_iterator it = program.functions.find(node.getName());
+        if (it == program.functions.end())
+            return failure("undefined function '" + node.getName() + "'", node.getLineNumber());
+        Instructions const &args = node.getParams();
+        if (it->second->getParams().size() != args.size())
+            return failure("wrong number of arguments to '" + node.getName() + "'", node.getLineNumber());
+
+        ostringstream call;
+        call << "pp_" << node.getName() << "(" << node.getLineNumber();
+        for (size_t i = 0; i != args.size(); ++i)
+            call << ", " << dispatch(args[i]);
+        call << ")";
+        return temp(call.str());
+    }
+
+    string visit(Operator const &node){
+        string left = dispatch(node.getLeft());
+        string right = dispatch(node.getRight());
+        switch (node.getOperation()) {
+        case '+': return temp("pp::add(" + left + ", " + right + ")");
+        case '-': return temp("pp::subtract(" + left + ", " + right + ")");
+        case '*': return temp("pp::multiply(" + left + ", " + right + ")");
+        case '/': return temp("pp::divide(" + left + ", " + right + ", " + number(node.getLineNumber()) + ")");
+        default: return failure(string("unknown operator '") + node.getOperation() + "'", node.getLineNumber());
+        }
+    }
+
+    string visit(Cond const &node){
+        string left = dispatch(node.getLeft());
+        string right = dispatch(node.getRight());
+        string const &comparison = node.getComparison();
+        if (comparison == "==" || comparison == "!=" || comparison == "<" ||
+            comparison == ">" || comparison == "<=" || comparison == ">=")
+            return temp("(" + left + " " + comparison + " " + right + ")");
+        return failure("unknown comparison '" + comparison + "'", node.getLineNumber());
+    }
+
+    string visit(If const &node){
+        string cond = dispatch(node.getCond());
+        line() << "if (" << cond << ") {\n";
+        ++indent;
+        body(node.getInstructions());
+        --indent;
+        line() << "}\n";
+        return "0";
+    }
+
+    string visit(While const &node){
+        line() << "while (true) {\n";
+        ++indent;
+        string cond = dispatch(node.getCond());
+        line() << "if (!" << cond << ") break;\n";
+        body(node.getInstructions());
+        --indent;
+        line() << "}\n";
+        return "0";
+    }
+
+    string visit(Return const &node){
+        string value = dispatch(node.getExp());
+        line() << "return " << (topLevel ? "0" : value) << ";\n";
+        return value;
+    }
+
+    string visit(Read const &node){
+        line() << variable(node.getVar()) << ".set(pp::read(" << quote(node.getVar()) << ", " << node.getLineNumber() << "));\n";
+        return "0";
+    }
+
+    string visit(Print const &node){
+        string value = dispatch(node.getExp());
+        line() << "pp::print(" << value << ");\n";
+        return value;
+    }
+
+    string visit(Index const &node){
+        string handle = temp(get(node.getName(), node.getLineNumber()));
+        string index = dispatch(node.getIndex());
+        return temp("pp::load(" + handle + ", " + index + ", " + number(node.getLineNumber()) + ")");
+    }
+
+    string visit(IndexAssign const &node){
+        string handle = temp(get(node.getName(), node.getLineNumber()));
+        string index = dispatch(node.getIndex());
+        string value = dispatch(node.getExp());
+        line() << "pp::store(" << handle << ", " << index << ", " << value << ", " << node.getLineNumber() << ");\n";
+        return value;
+    }
+
+    string visit(ArrayOp const &node){
+        Instructions const &params = node.getParams();
+        if (params.size() != ArrayOp::arity(node.getOperation()))
+            return failure(string("wrong number of arguments to '") + ArrayOp::name(node.getOperation()) + "'", node.getLineNumber());
+
+        ostringstream call;
+        call << "pp::" << (node.getOperation() == ArrayOp::NEW ? "newArray" : ArrayOp::name(node.getOperation())) << "(";
+        for (size_t i = 0; i != params.size(); ++i)
+            call << dispatch(params[i]) << ", ";
+        call << node.getLineNumber() << ")";
+        return temp(call.str());
+    }
+
+    string visit(InlinedCall const &node){
+        vector<string> const &temps = node.getTemps();
+        Instructions const &args = node.getArgs();
+        for (size_t i = 0; i != args.size(); ++i) {
+            string value = dispatch(args[i]);
+            line() << variable(temps[i]) << ".set(" << value << ");\n";
+        }
+        return dispatch(node.getBody());
+    }
+
+private:
+    ProgramContext const &program;
+    string const &sourceName;
+    bool topLevel;
+    int indent;
+    int temps;
+    ostringstream out;
+    set<string> variables;
+
+    ostream &line(){
+        for (int i = 0; i != indent; ++i) out << "    ";
+        return out;
+    }
+
+    static string number(size_t value){
+        ostringstream res;
+        res << value;
+        return res.str();
+    }
+
+    void statement(Instruction const &node){
+        line() << "// " << sourceName << ":" << node.getLineNumber() << "\n";
+        string value = dispatch(node);
+        switch (node.getKind()) {
+        case Instruction::NUM:
+        case Instruction::VAR:
+        case Instruction::FUN_CALL:
+        case Instruction::OPERATOR:
+        case Instruction::COND:
+        case Instruction::INDEX:
+        case Instruction::ARRAY_OP:
+        case Instruction::INLINED_CALL:
+            line() << "(void)" << value << ";\n";
+            break;
+        default:
+            break;
+        }
+    }
+
+    string temp(string const &expression){
+        ostringstream name;
+        name << "t" << ++temps;
+        line() << "int " << name.str() << " = " << expression << ";\n";
+        return name.str();
+    }
+
+    // Temporaries of inlined calls contain '#', and PP names have no '_'.
+    string variable(string const &name){
+        string res = name;
+        for (size_t i = 0; i != res.size(); ++i)
+            if (res[i] == '#') res[i] = '_';
+        variables.insert(res);
+        return "v_" + res;
+    }
+
+    string get(string const &name, size_t lineNumber){
+        return variable(name) + ".get(" + quote(name) + ", " + number(lineNumber) + ")";
+    }
+
+    string failure(string const &message, size_t lineNumber){
+        line() << "pp::fail(" << quote(message) << ", " << lineNumber << ");\n";
+        return "0";
+    }
+};
+
+}
+
+void emitCpp(ProgramContext const &program, string const &sourceName, ostream &out){
+    out << "// Generated from " << sourceName << " by PPInterpreter --emit-cpp.\n"
+        << "// Comments of the form \"// file:line\" map statements back to the PP source.\n\n"
+        << runtime << "\n";
+
+    for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it) {
+        out << "static int pp_" << it->first << "(size_t line";
+        vector<string> const &params = it->second->getParams();
+        for (size_t i = 0; i != params.size(); ++i)
+            out << ", int p_" << params[i];
+        out << ");\n";
+    }
+    out << "\n";
+
+    for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it) {
+        FunDef const &function = *it->second;
+        CppEmitter emitter(program, sourceName, false);
+        emitter.body(function.getInstructions());
+
+        vector<string> const &params = function.getParams();
+        out << "// " << sourceName << ":" << function.getLineNumber() << " def " << function.getName() << "\n";
+        out << "static int pp_" << function.getName() << "(size_t line";
+        for (size_t i = 0; i != params.size(); ++i)
+            out << ", int p_" << params[i];
+        out << "){\n"
+            << "    pp::Call call(" << quote(function.getName()) << ", line);\n"
+            << emitter.declarations(params)
+            << emitter.code()
+            << "    return 0;\n"
+            << "}\n\n";
+    }
+
+    InstructionList const &entry = static_cast<InstructionList const &>(*program.entryPoint);
+    CppEmitter emitter(program, sourceName, true);
+    emitter.body(entry.getInstructions());
+    out << "static int pp_main(){\n"
+        << emitter.declarations(vector<string>())
+        << emitter.code()
+        << "    return 0;\n"
+        << "}\n\n"
+        << "int main(){\n"
+        << "    char base = 0;\n"
+        << "    pp::limitStack(&base);\n"
+        << "    try {\n"
+        << "        pp_main();\n"
+        << "    } catch (pp::Error const &e) {\n"
+        << "        std::cout.flush();\n"
+        << "        std::cerr << " << quote(sourceName) << " << \":\" << e.line << \": \" << e.message << std::endl;\n"
+        << "        return 3;\n"
+        << "    }\n"
+        << "    return 0;\n"
+        << "}\n";
+}
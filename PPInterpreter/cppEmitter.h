@@ -0,0 +1,18 @@
+#ifndef CPPEMITTER_H
+#define CPPEMITTER_H
+
+#include <iostream>
+#include <string>
+#include "programContext.h"
+
+using std::ostream;
+using std::string;
+
+// Translates a program into one standalone C++ source file that behaves
+// like the interpreter: the same read/print format, wrap-around arithmetic,
+// evaluation order, error messages and exit codes. Each statement carries a
+// comment with its PP line, and runtime errors report that line prefixed
+// by sourceName.
+void emitCpp(ProgramContext const &program, string const &sourceName, ostream &out);
+
+#endif // CPPEMITTER_H
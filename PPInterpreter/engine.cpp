@@ -0,0 +1,88 @@
+#include <iterator>
+#include <sstream>
+#include "engine.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "loopIdioms.h"
+#include "inliner.h"
+#include "tiering.h"
+#include "trace.h"
+
+using std::istreambuf_iterator;
+using std::istringstream;
+
+static CompiledProgram compile(Parser &parser, CompileOptions const &options, CompilePhases *phases){
+    if (phases) {
+        phases->beginPhase("lex");
+        parser.lexAll();
+        phases->endPhase();
+        phases->beginPhase("parse");
+    }
+    ProgramContext parsed = parser.parse();
+    if (phases) {
+        phases->endPhase();
+        phases->beginPhase("inline");
+    }
+    shared_ptr<ProgramContext> program(new ProgramContext(inlineFunctions(parsed, options.inlineBudget)));
+    if (phases) phases->endPhase();
+    if (options.loopIdioms) {
+        if (phases) phases->beginPhase("idioms");
+        recognizeLoopIdioms(*program);
+        if (phases) phases->endPhase();
+    }
+    return program;
+}
+
+CompiledProgram compileProgram(istream &source, CompileOptions const &options, CompilePhases *phases){
+    source >> std::noskipws;
+    if (!options.lazyFunctions) {
+        Parser parser(source);
+        return compile(parser, options, phases);
+    }
+
+    // Lazy bodies are parsed later from this copy of the text.
+    shared_ptr<string const> text(new string(istreambuf_iterator<char>(source), istreambuf_iterator<char>()));
+    istringstream in(*text);
+    in >> std::noskipws;
+    Parser parser(in);
+    parser.setLazySource(text);
+    return compile(parser, options, phases);
+}
+
+shared_ptr<TierManager> createTiering(unsigned functionThreshold, unsigned loopThreshold, ostream *debug){
+    return shared_ptr<TierManager>(new TierManager(functionThreshold, loopThreshold, debug));
+}
+
+shared_ptr<TraceRecorder> createTrace(string const &path){
+    shared_ptr<TraceRecorder> trace(new TraceRecorder(path));
+    if (!trace->isOpen()) trace.reset();
+    return trace;
+}
+
+int runProgram(CompiledProgram const &program, InputOutput &io, RunOptions const &run){
+    ExecutionContext context(*program, io);
+    context.setStackSize(run.stackSize);
+    if (run.trace) context.setTrace(run.trace->attach());
+    else context.setTiering(run.tiering);
+    return context.run();
+}
+
+void runStreaming(istream &source, InputOutput &io, CompileOptions const &options, RunOptions const &run){
+    source >> std::noskipws;
+    Parser parser(source);
+    ProgramContext program = ProgramContext(InstructionPtr(), map<string, FunPtr>());
+    ExecutionContext context(program, io);
+    context.setStackSize(run.stackSize);
+    if (run.trace) context.setTrace(run.trace->attach());
+
+    InstructionPtr instruction;
+    FunPtr function;
+    while (parser.parseTopLevel(instruction, function)) {
+        if (function) program.functions[function->getName()] = function;
+        if (options.loopIdioms) {
+            if (function) recognizeLoopIdioms(*function, program);
+            if (instruction) recognizeLoopIdioms(*instruction, program);
+        }
+        if (instruction && !context.executeTopLevel(*instruction)) break;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <iostream>
+#include <string>
+#include <tr1/memory>
+#include "inputOutput.h"
+#include "runtimeError.h"
+
+using std::istream;
+using std::ostream;
+using std::string;
+using std::tr1::shared_ptr;
+
+// Public entry point for embedding PP. Programs, tiering and traces are
+// opaque handles here, so this header does not depend on the AST or the
+// internals of the interpreter.
+//
+// compileProgram() parses the source once. The returned program is never
+// modified afterwards, so it can be shared between threads; each thread
+// runs it with its own InputOutput.
+struct ProgramContext;
+class TierManager;
+class TraceRecorder;
+
+typedef shared_ptr<ProgramContext const> CompiledProgram;
+
+struct CompileOptions {
+    // Parse def bodies on their first call instead of up front.
+    bool lazyFunctions;
+    // Run recognized reduction loops without iterating (see loopIdioms.h).
+    // Bodies of lazy defs are not analyzed.
+    bool loopIdioms;
+    // Largest expression, in AST nodes, that a call may be replaced with
+    // (see inliner.h); 0 turns inlining off.
+    size_t inlineBudget;
+
+    CompileOptions():
+        lazyFunctions(false),
+        loopIdioms(true),
+        inlineBudget(16)
+    {}
+};
+
+// Told when each step of compileProgram() starts and ends: "lex",
+// "parse", "inline" and, with loopIdioms, "idioms". With a listener the
+// whole source is lexed before parsing starts.
+class CompilePhases {
+public:
+    virtual ~CompilePhases() {}
+
+    virtual void beginPhase(string const &name) = 0;
+    virtual void endPhase() = 0;
+};
+
+CompiledProgram compileProgram(istream &source, CompileOptions const &options = CompileOptions(), CompilePhases *phases = 0);
+
+// Moves hot code of the runs that use it to bytecode, compiling on a
+// background thread. It must be released before the programs it ran.
+shared_ptr<TierManager> createTiering(unsigned functionThreshold = 1000, unsigned loopThreshold = 1000, ostream *debug = 0);
+
+// Records the runs that use it into path for pptracedecode. Null if path
+// cannot be written; the file is complete once the handle is released.
+shared_ptr<TraceRecorder> createTrace(string const &path);
+
+struct RunOptions {
+    // Both may be shared by any number of concurrent runs. A traced run
+    // stays in the AST tier, so that every event is recorded.
+    TierManager *tiering;
+    TraceRecorder *trace;
+    // Size in bytes of the native stack of the calling thread, for threads
+    // started with less than RLIMIT_STACK; 0 means RLIMIT_STACK. Recursion
+    // that would exceed it fails with a RuntimeError.
+    size_t stackSize;
+
+    RunOptions():
+        tiering(0),
+        trace(0),
+        stackSize(0)
+    {}
+};
+
+int runProgram(CompiledProgram const &program, InputOutput &io, RunOptions const &run = RunOptions());
+
+// Executes each top-level statement as soon as it is parsed and drops it
+// afterwards. A def becomes callable once it has been read, so a call
+// that precedes the definition in the source fails in this mode.
+// A later def may replace it, so the run stays in the AST tier and
+// nothing is inlined: of the options only loopIdioms and, of run, trace
+// and stackSize apply.
+void runStreaming(istream &source, InputOutput &io, CompileOptions const &options = CompileOptions(), RunOptions const &run = RunOptions());
+
+#endif // ENGINE_H
@@ -0,0 +1,44 @@
+SOURCES += \
+    $$PWD/lexer.cpp \
+    $$PWD/parser.cpp \
+    $$PWD/interpreter.cpp \
+    $$PWD/arrayKernels.cpp \
+    $$PWD/bytecode.cpp \
+    $$PWD/tiering.cpp \
+    $$PWD/engine.cpp \
+    $$PWD/cppEmitter.cpp \
+    $$PWD/loopIdioms.cpp \
+    $$PWD/inliner.cpp \
+    $$PWD/trace.cpp
+
+HEADERS += \
+    $$PWD/lexer.h \
+    $$PWD/ast.h \
+    $$PWD/Token.h \
+    $$PWD/parser.h \
+    $$PWD/programContext.h \
+    $$PWD/visitor.h \
+    $$PWD/staticVisitor.h \
+    $$PWD/inputOutput.h \
+    $$PWD/interpreter.h \
+    $$PWD/runtimeError.h \
+    $$PWD/arrayKernels.h \
+    $$PWD/bytecode.h \
+    $$PWD/tiering.h \
+    $$PWD/engine.h \
+    $$PWD/cppEmitter.h \
+    $$PWD/loopIdioms.h \
+    $$PWD/inliner.h \
+    $$PWD/trace.h
+
+INCLUDEPATH += $$PWD
+
+# The tiering compiler runs on a background thread.
+LIBS += -pthread
+QMAKE_CXXFLAGS += -pthread
+
+# Green-thread scheduler, built on POSIX ucontext.
+unix {
+    SOURCES += $$PWD/scheduler.cpp
+    HEADERS += $$PWD/scheduler.h
+}
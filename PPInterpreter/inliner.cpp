@@ -0,0 +1,381 @@
+#include <climits>
+#include <set>
+#include <sstream>
+#include "inliner.h"
+
+using std::set;
+using std::ostringstream;
+
+namespace {
+
+class Inliner {
+public:
+    Inliner(ProgramContext const &program, size_t budget):
+        program(program),
+        budget(budget),
+        temps(0)
+    {
+        for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it)
+            if (it->second->isParsed()) collectCalls(it->second->getInstructions(), calls[it->first]);
+    }
+
+    ProgramContext run(){
+        map<string, FunPtr> functions;
+        for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it) {
+            FunDef const &function = *it->second;
+            if (!function.isParsed()) {
+                functions[it->first] = it->second;
+                continue;
+            }
+            functions[it->first] = FunPtr(new FunDef(function.getName(), function.getParams(),
+                                                     statements(function.getInstructions()), function.getLineNumber()));
+        }
+        return ProgramContext(statement(program.entryPoint), functions);
+    }
+
+private:
+    // Names bound by an inlined call: parameters replaced by numbers and
+    // parameters renamed to temporaries.
+    struct Substitution {
+        map<string, InstructionPtr> constants;
+        map<string, string> renames;
+    };
+
+    ProgramContext const &program;
+    size_t budget;
+    int temps;
+    map<string, set<string> > calls;
+    // Inlined body of each def looked at so far, null if it is not inlined.
+    map<string, InstructionPtr> bodies;
+
+    static void collectCalls(Instructions const &nodes, set<string> &res){
+        for (size_t i = 0; i != nodes.size(); ++i)
+            if (nodes[i]) collectCalls(*nodes[i], res);
+    }
+
+    static void collectCalls(Instruction const &node, set<string> &res){
+        switch (node.getKind()) {
+        case Instruction::VAR_DEF:
+            if (static_cast<VarDef const &>(node).getExp()) collectCalls(*static_cast<VarDef const &>(node).getExp(), res);
+            break;
+        case Instruction::RETURN:
+            if (static_cast<Return const &>(node).getExp()) collectCalls(*static_cast<Return const &>(node).getExp(), res);
+            break;
+        case Instruction::PRINT:
+            if (static_cast<Print const &>(node).getExp()) collectCalls(*static_cast<Print const &>(node).getExp(), res);
+            break;
+        case Instruction::OPERATOR: {
+            Operator const &op = static_cast<Operator const &>(node);
+            if (op.getLeft()) collectCalls(*op.getLeft(), res);
+            if (op.getRight()) collectCalls(*op.getRight(), res);
+            break;
+        }
+        case Instruction::COND: {
+            Cond const &cond = static_cast<Cond const &>(node);
+            if (cond.getLeft()) collectCalls(*cond.getLeft(), res);
+            if (cond.getRight()) collectCalls(*cond.getRight(), res);
+            break;
+        }
+        case Instruction::IF:
+            if (static_cast<If const &>(node).getCond()) collectCalls(*static_cast<If const &>(node).getCond(), res);
+            collectCalls(static_cast<If const &>(node).getInstructions(), res);
+            break;
+        case Instruction::WHILE:
+            if (static_cast<While const &>(node).getCond()) collectCalls(*static_cast<While const &>(node).getCond(), res);
+            collectCalls(static_cast<While const &>(node).getInstructions(), res);
+            break;
+        case Instruction::FUN_CALL:
+            res.insert(static_cast<FunCall const &>(node).getName());
+            collectCalls(static_cast<FunCall const &>(node).getParams(), res);
+            break;
+        case Instruction::INDEX:
+            if (static_cast<Index const &>(node).getIndex()) collectCalls(*static_cast<Index const &>(node).getIndex(), res);
+            break;
+        case Instruction::INDEX_ASSIGN: {
+            IndexAssign const &assign = static_cast<IndexAssign const &>(node);
+            if (assign.getIndex()) collectCalls(*assign.getIndex(), res);
+            if (assign.getExp()) collectCalls(*assign.getExp(), res);
+            break;
+        }
+        case Instruction::ARRAY_OP:
+            collectCalls(static_cast<ArrayOp const &>(node).getParams(), res);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // True if name can reach itself in the call graph. Lazy defs are
+    // not in the graph, so a cycle through one is not seen; they are
+    // never inlined either.
+    bool isRecursive(string const &name) const{
+        set<string> visited;
+        vector<string> pending(1, name);
+        while (!pending.empty()) {
+            string current = pending.back();
+            pending.pop_back();
+            map<string, set<string> >::const_iterator it = calls.find(current);
+            if (it == calls.end()) continue;
+            for (set<string>::const_iterator callee = it->second.begin(); callee != it->second.end(); ++callee) {
+                if (*callee == name) return true;
+                if (visited.insert(*callee).second) pending.push_back(*callee);
+            }
+        }
+        return false;
+    }
+
+    static bool readsOnly(Instruction const &node, vector<string> const &params){
+        switch (node.getKind()) {
+        case Instruction::NUM:
+            return true;
+        case Instruction::VAR:
+            for (size_t i = 0; i != params.size(); ++i)
+                if (params[i] == static_cast<Var const &>(node).getName()) return true;
+            return false;
+        case Instruction::OPERATOR: {
+            Operator const &op = static_cast<Operator const &>(node);
+            return op.getLeft() && op.getRight() && readsOnly(*op.getLeft(), params) && readsOnly(*op.getRight(), params);
+        }
+        case Instruction::COND: {
+            Cond const &cond = static_cast<Cond const &>(node);
+            return cond.getLeft() && cond.getRight() && readsOnly(*cond.getLeft(), params) && readsOnly(*cond.getRight(), params);
+        }
+        case Instruction::FUN_CALL: {
+            Instructions const &args = static_cast<FunCall const &>(node).getParams();
+            for (size_t i = 0; i != args.size(); ++i)
+                if (!args[i] || !readsOnly(*args[i], params)) return false;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    static size_t size(Instruction const &node){
+        switch (node.getKind()) {
+        case Instruction::OPERATOR:
+            return 1 + size(*static_cast<Operator const &>(node).getLeft()) + size(*static_cast<Operator const &>(node).getRight());
+        case Instruction::COND:
+            return 1 + size(*static_cast<Cond const &>(node).getLeft()) + size(*static_cast<Cond const &>(node).getRight());
+        case Instruction::FUN_CALL:
+            return 1 + size(static_cast<FunCall const &>(node).getParams());
+        case Instruction::INLINED_CALL:
+            return 1 + size(static_cast<InlinedCall const &>(node).getArgs()) + size(*static_cast<InlinedCall const &>(node).getBody());
+        default:
+            return 1;
+        }
+    }
+
+    static size_t size(Instructions const &nodes){
+        size_t res = 0;
+        for (size_t i = 0; i != nodes.size(); ++i)
+            res += size(*nodes[i]);
+        return res;
+    }
+
+    InstructionPtr body(FunDef const &function){
+        map<string, InstructionPtr>::const_iterator it = bodies.find(function.getName());
+        if (it != bodies.end()) return it->second;
+        InstructionPtr &res = bodies[function.getName()];
+
+        if (budget == 0 || !function.isParsed() || isRecursive(function.getName())) return res;
+        Instructions const &instructions = function.getInstructions();
+        if (instructions.size() != 1 || !instructions[0] || instructions[0]->getKind() != Instruction::RETURN) return res;
+        InstructionPtr const &exp = static_cast<Return const &>(*instructions[0]).getExp();
+        if (!exp || !readsOnly(*exp, function.getParams())) return res;
+
+        InstructionPtr inlined = expression(exp);
+        if (size(*inlined) <= budget) res = inlined;
+        return res;
+    }
+
+    string temp(string const &name){
+        ostringstream res;
+        res << name.substr(0, name.find('#')) << '#' << ++temps;
+        return res.str();
+    }
+
+    // Copies body with names bound to args. Number args are substituted;
+    // the others are evaluated into fresh temporaries first.
+    InstructionPtr bind(string const &function, vector<string> const &names, Instructions const &args,
+                        InstructionPtr const &body, size_t lineNumber, Substitution substitution){
+        vector<string> bound;
+        Instructions values;
+        for (size_t i = 0; i != names.size(); ++i) {
+            if (args[i] && args[i]->getKind() == Instruction::NUM) {
+                substitution.constants[names[i]] = args[i];
+                continue;
+            }
+            string name = temp(names[i]);
+            substitution.renames[names[i]] = name;
+            bound.push_back(name);
+            values.push_back(args[i]);
+        }
+        InstructionPtr res = copy(body, substitution);
+        if (bound.empty()) return res;
+        return InstructionPtr(new InlinedCall(function, bound, values, res, lineNumber));
+    }
+
+    InstructionPtr copy(InstructionPtr const &node, Substitution const &substitution){
+        if (!node) return node;
+        switch (node->getKind()) {
+        case Instruction::VAR: {
+            string const &name = static_cast<Var const &>(*node).getName();
+            map<string, InstructionPtr>::const_iterator constant = substitution.constants.find(name);
+            if (constant != substitution.constants.end()) return constant->second;
+            map<string, string>::const_iterator rename = substitution.renames.find(name);
+            if (rename != substitution.renames.end()) return InstructionPtr(new Var(rename->second, node->getLineNumber()));
+            return node;
+        }
+        case Instruction::OPERATOR: {
+            Operator const &op = static_cast<Operator const &>(*node);
+            return fold(op.getOperation(), copy(op.getLeft(), substitution), copy(op.getRight(), substitution), op.getLineNumber());
+        }
+        case Instruction::COND: {
+            Cond const &cond = static_cast<Cond const &>(*node);
+            return fold(cond.getComparison(), copy(cond.getLeft(), substitution), copy(cond.getRight(), substitution), cond.getLineNumber());
+        }
+        case Instruction::FUN_CALL: {
+            FunCall const &call = static_cast<FunCall const &>(*node);
+            Instructions args;
+            for (size_t i = 0; i != call.getParams().size(); ++i)
+                args.push_back(copy(call.getParams()[i], substitution));
+            return InstructionPtr(new FunCall(call.getName(), args, call.getLineNumber()));
+        }
+        case Instruction::INLINED_CALL: {
+            InlinedCall const &call = static_cast<InlinedCall const &>(*node);
+            Instructions args;
+            for (size_t i = 0; i != call.getArgs().size(); ++i)
+                args.push_back(copy(call.getArgs()[i], substitution));
+            return bind(call.getName(), call.getTemps(), args, call.getBody(), call.getLineNumber(), substitution);
+        }
+        default:
+            return node;
+        }
+    }
+
+    // Operators on two numbers become a number, except division by zero,
+    // which has to fail when it runs.
+    static InstructionPtr fold(char operation, InstructionPtr const &left, InstructionPtr const &right, size_t lineNumber){
+        if (left && right && left->getKind() == Instruction::NUM && right->getKind() == Instruction::NUM) {
+            unsigned l = static_cast<Num const &>(*left).getValue();
+            unsigned r = static_cast<Num const &>(*right).getValue();
+            switch (operation) {
+            case '+': return InstructionPtr(new Num(static_cast<int>(l + r), lineNumber));
+            case '-': return InstructionPtr(new Num(static_cast<int>(l - r), lineNumber));
+            case '*': return InstructionPtr(new Num(static_cast<int>(l * r), lineNumber));
+            case '/':
+                if (r == 0) break;
+                if (static_cast<int>(l) == INT_MIN && static_cast<int>(r) == -1) return InstructionPtr(new Num(INT_MIN, lineNumber));
+                return InstructionPtr(new Num(static_cast<int>(l) / static_cast<int>(r), lineNumber));
+            default:
+                break;
+            }
+        }
+        return InstructionPtr(new Operator(operation, left, right, lineNumber));
+    }
+
+    static InstructionPtr fold(string const &comparison, InstructionPtr const &left, InstructionPtr const &right, size_t lineNumber){
+        if (left && right && left->getKind() == Instruction::NUM && right->getKind() == Instruction::NUM) {
+            int l = static_cast<Num const &>(*left).getValue();
+            int r = static_cast<Num const &>(*right).getValue();
+            int value = -1;
+            if (comparison == "==") value = l == r;
+            else if (comparison == "!=") value = l != r;
+            else if (comparison == "<") value = l < r;
+            else if (comparison == ">") value = l > r;
+            else if (comparison == "<=") value = l <= r;
+            else if (comparison == ">=") value = l >= r;
+            if (value != -1) return InstructionPtr(new Num(value, lineNumber));
+        }
+        return InstructionPtr(new Cond(left, right, comparison, lineNumber));
+    }
+
+    Instructions expressions(Instructions const &nodes){
+        Instructions res;
+        for (size_t i = 0; i != nodes.size(); ++i)
+            res.push_back(expression(nodes[i]));
+        return res;
+    }
+
+    InstructionPtr expression(InstructionPtr const &node){
+        if (!node) return node;
+        switch (node->getKind()) {
+        case Instruction::OPERATOR: {
+            Operator const &op = static_cast<Operator const &>(*node);
+            return fold(op.getOperation(), expression(op.getLeft()), expression(op.getRight()), op.getLineNumber());
+        }
+        case Instruction::COND: {
+            Cond const &cond = static_cast<Cond const &>(*node);
+            return fold(cond.getComparison(), expression(cond.getLeft()), expression(cond.getRight()), cond.getLineNumber());
+        }
+        case Instruction::FUN_CALL: {
+            FunCall const &call = static_cast<FunCall const &>(*node);
+            Instructions args = expressions(call.getParams());
+            map<string, FunPtr>::const_iterator it = program.functions.find(call.getName());
+            // Unknown defs and wrong arities keep their call, which fails
+            // when it runs.
+            if (it != program.functions.end() && it->second->getParams().size() == args.size()) {
+                InstructionPtr inlined = body(*it->second);
+                if (inlined)
+                    return bind(call.getName(), it->second->getParams(), args, inlined, call.getLineNumber(), Substitution());
+            }
+            return InstructionPtr(new FunCall(call.getName(), args, call.getLineNumber()));
+        }
+        case Instruction::INDEX: {
+            Index const &index = static_cast<Index const &>(*node);
+            return InstructionPtr(new Index(index.getName(), expression(index.getIndex()), index.getLineNumber()));
+        }
+        case Instruction::ARRAY_OP: {
+            ArrayOp const &op = static_cast<ArrayOp const &>(*node);
+            return InstructionPtr(new ArrayOp(op.getOperation(), expressions(op.getParams()), op.getLineNumber()));
+        }
+        default:
+            return node;
+        }
+    }
+
+    Instructions statements(Instructions const &nodes){
+        Instructions res;
+        for (size_t i = 0; i != nodes.size(); ++i)
+            res.push_back(statement(nodes[i]));
+        return res;
+    }
+
+    InstructionPtr statement(InstructionPtr const &node){
+        if (!node) return node;
+        size_t line = node->getLineNumber();
+        switch (node->getKind()) {
+        case Instruction::PROGRAM:
+            return InstructionPtr(new Program(statements(static_cast<Program const &>(*node).getInstructions()), line));
+        case Instruction::VAR_DEF: {
+            VarDef const &def = static_cast<VarDef const &>(*node);
+            return InstructionPtr(new VarDef(def.getName(), expression(def.getExp()), line));
+        }
+        case Instruction::IF: {
+            If const &branch = static_cast<If const &>(*node);
+            return InstructionPtr(new If(expression(branch.getCond()), statements(branch.getInstructions()), line));
+        }
+        case Instruction::WHILE: {
+            While const &loop = static_cast<While const &>(*node);
+            return InstructionPtr(new While(expression(loop.getCond()), statements(loop.getInstructions()), line));
+        }
+        case Instruction::RETURN:
+            return InstructionPtr(new Return(expression(static_cast<Return const &>(*node).getExp()), line));
+        case Instruction::PRINT:
+            return InstructionPtr(new Print(expression(static_cast<Print const &>(*node).getExp()), line));
+        case Instruction::INDEX_ASSIGN: {
+            IndexAssign const &assign = static_cast<IndexAssign const &>(*node);
+            return InstructionPtr(new IndexAssign(assign.getName(), expression(assign.getIndex()), expression(assign.getExp()), line));
+        }
+        default:
+            return expression(node);
+        }
+    }
+};
+
+}
+
+ProgramContext inlineFunctions(ProgramContext const &program, size_t budget){
+    return Inliner(program, budget).run();
+}
@@ -0,0 +1,17 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include <cstddef>
+#include "programContext.h"
+
+// Returns a copy of program in which calls to small defs are replaced by
+// InlinedCall nodes holding their bodies, and operators on constants are
+// folded. A def is inlined when its body is a single return whose
+// expression reads only its parameters, it cannot reach itself through
+// calls, and its expression, after inlining the calls inside it, has at
+// most budget nodes. Args that are numbers are substituted directly, so
+// the folding continues into the inlined body. Unparsed lazy defs are
+// kept as they are. A budget of 0 only folds.
+ProgramContext inlineFunctions(ProgramContext const &program, size_t budget);
+
+#endif // INLINER_H
@@ -0,0 +1,40 @@
+#ifndef INPUTOUTPUT_H
+#define INPUTOUTPUT_H
+
+#include <iostream>
+
+using std::istream;
+using std::ostream;
+
+// Callbacks used by read and print. One instance belongs to one
+// ExecutionContext, so implementations need no locking of their own.
+class InputOutput {
+public:
+    virtual ~InputOutput() {}
+
+    // Returns false when no more input is available.
+    virtual bool read(int &value) = 0;
+    virtual void print(int value) = 0;
+};
+
+class StreamInputOutput: public InputOutput {
+public:
+    StreamInputOutput(istream &in, ostream &out):
+        in(in),
+        out(out)
+    {}
+
+    bool read(int &value){
+        return static_cast<bool>(in >> value);
+    }
+
+    void print(int value){
+        out << value << '\n';
+    }
+
+private:
+    istream &in;
+    ostream &out;
+};
+
+#endif // INPUTOUTPUT_H
@@ -0,0 +1,622 @@
+#include <climits>
+#include <new>
+#include <thread>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "interpreter.h"
+#include "arrayKernels.h"
+
+ExecutionContext::ExecutionContext(ProgramContext const &program, InputOutput &io):
+    program(program),
+    io(io),
+    stackBottom(0),
+    stackSize(0),
+    stackLimit(0),
+    preemption(0),
+    budget(UINT_MAX),
+    remainingBudget(UINT_MAX),
+    tiering(0),
+    trace(0),
+    arrayElements(0)
+{}
+
+void ExecutionContext::setPreemption(Preemption *preemption, unsigned budget){
+    this->preemption = preemption;
+    this->budget = budget ? budget : UINT_MAX;
+    remainingBudget = this->budget;
+}
+
+void ExecutionContext::budgetExhausted(){
+    remainingBudget = budget;
+    if (preemption) preemption->yield();
+}
+
+// Lowest address a stack of size bytes, 0 for the default, may reach,
+// leaving an eighth of it for the frames above base and for what runs
+// between two checks: io, tiering and throwing the error.
+static char const *stackLimitBelow(char const *base, size_t size){
+    if (size == 0) {
+        // The default stack of the main thread on Windows.
+        size = 1 << 20;
+#ifndef _WIN32
+        // glibc gives new threads 2 MB when the limit is infinite.
+        size = 2 << 20;
+        rlimit limit;
+        if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+            size = limit.rlim_cur;
+#endif
+    }
+    uintptr_t usable = size - size / 8;
+    uintptr_t address = reinterpret_cast<uintptr_t>(base);
+    return reinterpret_cast<char const *>(address > usable ? address - usable : 0);
+}
+
+void ExecutionContext::limitStack(){
+    char base = 0;
+    stackLimit = stackBottom ? stackBottom : stackLimitBelow(&base, stackSize);
+}
+
+int ExecutionContext::run(){
+    limitStack();
+    frames.clear();
+    registers.clear();
+    defined.clear();
+    arrays.clear();
+    arrayElements = 0;
+    frames.push_back(Frame());
+    int res = dispatch(program.entryPoint);
+    frames.clear();
+    return res;
+}
+
+bool ExecutionContext::executeTopLevel(Instruction const &instruction){
+    if (frames.empty()) {
+        limitStack();
+        frames.push_back(Frame());
+    }
+    dispatch(instruction);
+    return !currentFrame().returned;
+}
+
+bool ExecutionContext::execute(Instructions const &instructions){
+    for (Instructions::const_iterator it = instructions.begin(); it != instructions.end(); ++it) {
+        dispatch(*it);
+        if (currentFrame().returned) return true;
+    }
+    return false;
+}
+
+int ExecutionContext::visit(Program const &node){
+    execute(node.getInstructions());
+    return currentFrame().returnValue;
+}
+
+int ExecutionContext::visit(FunDef const &node){
+    execute(node.getInstructions());
+    return currentFrame().returnValue;
+}
+
+int ExecutionContext::visit(VarDef const &node){
+    int value = dispatch(node.getExp());
+    currentFrame().variables[node.getName()] = value;
+    return value;
+}
+
+int ExecutionContext::visit(Num const &node){
+    return node.getValue();
+}
+
+int ExecutionContext::visit(Var const &node){
+    return lookup(node.getName(), node.getLineNumber());
+}
+
+int ExecutionContext::lookup(string const &name, size_t lineNumber){
+    map<string, int> const &variables = currentFrame().variables;
+    map<string, int>::const_iterator it = variables.find(name);
+    if (it == variables.end())
+        throw RuntimeError("undefined variable '" + name + "'", lineNumber);
+    return it->second;
+}
+
+int ExecutionContext::visit(FunCall const &node){
+    checkStack(node.getLineNumber());
+    map<string, FunPtr>::const_iterator it = program.functions.find(node.getName());
+    if (it == program.functions.end())
+        throw RuntimeError("undefined function '" + node.getName() + "'", node.getLineNumber());
+
+    FunDef const &function = *it->second;
+    Instructions const &args = node.getParams();
+    if (function.getParams().size() != args.size())
+        throw RuntimeError("wrong number of arguments to '" + node.getName() + "'", node.getLineNumber());
+
+    int small[8];
+    vector<int> large;
+    int *values = small;
+    if (args.size() > 8) {
+        large.resize(args.size());
+        values = &large[0];
+    }
+    for (size_t i = 0; i != args.size(); ++i)
+        values[i] = dispatch(args[i]);
+
+    return call(function, values, node.getLineNumber());
+}
+
+int ExecutionContext::call(FunDef const &function, int const *args, size_t lineNumber){
+    checkStack(lineNumber);
+    tick();
+    if (trace) trace->record(TraceEvent::CALL, lineNumber, trace->nameOf(function));
+
+    int res = 0;
+    vector<string> const &params = function.getParams();
+    Bytecode const *code = tiering ? tiering->enter(function, program) : 0;
+    try {
+        if (code) {
+            size_t base = allocateRegisters(*code);
+            for (size_t i = 0; i != params.size(); ++i) {
+                registers[base + i] = args[i];
+                defined[base + i] = 1;
+            }
+            frames.push_back(Frame());
+            bool returned = false;
+            res = runBytecode(*code, base, returned);
+            frames.pop_back();
+            releaseRegisters(base);
+        } else {
+            frames.push_back(Frame());
+            map<string, int> &variables = frames.back().variables;
+            for (size_t i = 0; i != params.size(); ++i)
+                variables[params[i]] = args[i];
+            res = visit(function);
+            frames.pop_back();
+        }
+    } catch (...) {
+        // Every CALL gets its end, also when an error leaves the call.
+        if (trace) trace->record(TraceEvent::UNWIND, lineNumber, 0);
+        throw;
+    }
+
+    if (trace) trace->record(TraceEvent::RETURN, lineNumber, res);
+    return res;
+}
+
+// Arithmetic wraps around like two's complement hardware instead of
+// being undefined on overflow. Shared by both tiers.
+static inline int add(int left, int right){
+    return static_cast<int>(static_cast<unsigned>(left) + static_cast<unsigned>(right));
+}
+
+static inline int subtract(int left, int right){
+    return static_cast<int>(static_cast<unsigned>(left) - static_cast<unsigned>(right));
+}
+
+static inline int multiply(int left, int right){
+    return static_cast<int>(static_cast<unsigned>(left) * static_cast<unsigned>(right));
+}
+
+static inline int divide(int left, int right, size_t lineNumber){
+    if (right == 0)
+        throw RuntimeError("division by zero", lineNumber);
+    if (left == INT_MIN && right == -1)
+        return INT_MIN;
+    return left / right;
+}
+
+int ExecutionContext::visit(Operator const &node){
+    checkStack(node.getLineNumber());
+    int left = dispatch(node.getLeft());
+    int right = dispatch(node.getRight());
+    switch (node.getOperation()) {
+    case '+': return add(left, right);
+    case '-': return subtract(left, right);
+    case '*': return multiply(left, right);
+    case '/': return divide(left, right, node.getLineNumber());
+    default:
+        throw RuntimeError(string("unknown operator '") + node.getOperation() + "'", node.getLineNumber());
+    }
+}
+
+int ExecutionContext::visit(Cond const &node){
+    int left = dispatch(node.getLeft());
+    int right = dispatch(node.getRight());
+    string const &comparison = node.getComparison();
+    if (comparison == "==") return left == right;
+    if (comparison == "!=") return left != right;
+    if (comparison == "<") return left < right;
+    if (comparison == ">") return left > right;
+    if (comparison == "<=") return left <= right;
+    if (comparison == ">=") return left >= right;
+    throw RuntimeError("unknown comparison '" + comparison + "'", node.getLineNumber());
+}
+
+int ExecutionContext::visit(If const &node){
+    int cond = dispatch(node.getCond());
+    if (trace) trace->record(TraceEvent::IF, node.getLineNumber(), cond != 0);
+    if (cond)
+        execute(node.getInstructions());
+    return 0;
+}
+
+int ExecutionContext::visit(While const &node){
+    LoopIdiom const *idiom = node.getIdiom();
+    // A traced loop runs every iteration so that each one is recorded.
+    if (idiom && !trace && runIdiom(*idiom)) return 0;
+    if (tiering) {
+        Bytecode const *code = tiering->loopCode(node);
+        if (code) return runLoop(*code);
+    }
+    while (true) {
+        int cond = dispatch(node.getCond());
+        if (trace) trace->record(TraceEvent::WHILE, node.getLineNumber(), cond != 0);
+        if (!cond) break;
+        if (execute(node.getInstructions())) break;
+        tick();
+        if (!tiering) continue;
+        Bytecode const *code = tiering->backEdge(node, program);
+        if (code) {
+            tiering->onStackReplacement(node);
+            return runLoop(*code);
+        }
+    }
+    return 0;
+}
+
+// Runs a recognized reduction without iterating. Returns false if the
+// shortcut does not apply this time; the loop then runs as written, which
+// also reports any error at the right place.
+bool ExecutionContext::runIdiom(LoopIdiom const &idiom){
+    map<string, int> &variables = currentFrame().variables;
+    map<string, int>::iterator counter = variables.find(idiom.counter);
+    map<string, int>::iterator accumulator = variables.find(idiom.accumulator);
+    if (counter == variables.end() || accumulator == variables.end()) return false;
+
+    int bound = 0;
+    if (idiom.bound->getKind() == Instruction::NUM) {
+        bound = static_cast<Num const &>(*idiom.bound).getValue();
+    } else {
+        map<string, int>::const_iterator it = variables.find(static_cast<Var const &>(*idiom.bound).getName());
+        if (it == variables.end()) return false;
+        bound = it->second;
+    }
+    // i <= INT_MAX never fails, the counter wraps instead.
+    if (idiom.inclusive && bound == INT_MAX) return false;
+
+    int first = counter->second;
+    long long count = static_cast<long long>(bound) - first + (idiom.inclusive ? 1 : 0);
+    if (count <= 0) return true;
+
+    unsigned total = 0;
+    if (idiom.kind == LoopIdiom::CLOSED_FORM) {
+        if (!sumPolynomial(idiom, variables, first, count, total)) return false;
+    } else if (!reduceInParallel(idiom, first, count, total)) {
+        return false;
+    }
+
+    unsigned sum = static_cast<unsigned>(accumulator->second);
+    accumulator->second = static_cast<int>(idiom.subtract ? sum - total : sum + total);
+    counter->second = static_cast<int>(first + count);
+    return true;
+}
+
+// Splits the iterations of a PARALLEL idiom between threads, each with
+// its own context holding a copy of the current frame. Unsigned partial
+// sums combine to the same wrapped result in any order. If any chunk
+// fails, the caller reruns the loop sequentially to get the same error.
+bool ExecutionContext::reduceInParallel(LoopIdiom const &idiom, int first, long long count, unsigned &total){
+    unsigned threads = std::thread::hardware_concurrency();
+    // Under a scheduler the contexts already share the cores.
+    if (preemption || threads < 2 || count < 1024) return false;
+    // Recognition saw only the defs read so far.
+    if (!isPureTerm(idiom, program)) return false;
+
+    vector<Chunk> chunks(threads);
+    vector<std::thread> workers;
+    for (unsigned t = 0; t != threads; ++t) {
+        long long begin = count * t / threads;
+        long long end = count * (t + 1) / threads;
+        chunks[t].first = static_cast<int>(first + begin);
+        chunks[t].count = end - begin;
+        workers.push_back(std::thread(&ExecutionContext::reduceChunk, this, &idiom, &chunks[t]));
+    }
+    for (unsigned t = 0; t != threads; ++t)
+        workers[t].join();
+
+    total = 0;
+    for (unsigned t = 0; t != threads; ++t) {
+        if (chunks[t].failed) return false;
+        total += chunks[t].total;
+    }
+    return true;
+}
+
+void ExecutionContext::reduceChunk(LoopIdiom const *idiom, Chunk *chunk){
+    try {
+        ExecutionContext worker(program, io);
+        worker.setTiering(tiering);
+        worker.limitStack();
+        worker.frames.push_back(Frame());
+        worker.currentFrame().variables = currentFrame().variables;
+        chunk->total = worker.reduce(*idiom, chunk->first, chunk->count);
+    } catch (...) {
+        chunk->failed = true;
+    }
+}
+
+unsigned ExecutionContext::reduce(LoopIdiom const &idiom, int first, long long count){
+    unsigned total = 0;
+    for (long long k = 0; k != count; ++k) {
+        frames.front().variables[idiom.counter] = static_cast<int>(first + k);
+        total += static_cast<unsigned>(dispatch(idiom.term));
+    }
+    return total;
+}
+
+int ExecutionContext::visit(Return const &node){
+    int value = dispatch(node.getExp());
+    Frame &frame = currentFrame();
+    frame.returned = true;
+    frame.returnValue = value;
+    return value;
+}
+
+int ExecutionContext::visit(Read const &node){
+    int value = 0;
+    if (!io.read(value))
+        throw RuntimeError("no input for '" + node.getVar() + "'", node.getLineNumber());
+    currentFrame().variables[node.getVar()] = value;
+    if (trace) trace->record(TraceEvent::READ, node.getLineNumber(), value);
+    return value;
+}
+
+int ExecutionContext::visit(Print const &node){
+    int value = dispatch(node.getExp());
+    if (trace) trace->record(TraceEvent::PRINT, node.getLineNumber(), value);
+    io.print(value);
+    return value;
+}
+
+int ExecutionContext::visit(Index const &node){
+    int handle = lookup(node.getName(), node.getLineNumber());
+    int index = dispatch(node.getIndex());
+    return loadIndex(handle, index, node.getLineNumber());
+}
+
+int ExecutionContext::visit(IndexAssign const &node){
+    int handle = lookup(node.getName(), node.getLineNumber());
+    int index = dispatch(node.getIndex());
+    int value = dispatch(node.getExp());
+    storeIndex(handle, index, value, node.getLineNumber());
+    return value;
+}
+
+int ExecutionContext::visit(ArrayOp const &node){
+    Instructions const &params = node.getParams();
+    if (params.size() != ArrayOp::arity(node.getOperation()))
+        throw RuntimeError(string("wrong number of arguments to '") + ArrayOp::name(node.getOperation()) + "'", node.getLineNumber());
+
+    int args[3];
+    for (size_t i = 0; i != params.size(); ++i)
+        args[i] = dispatch(params[i]);
+    return arrayOp(node.getOperation(), args, node.getLineNumber());
+}
+
+int ExecutionContext::visit(InlinedCall const &node){
+    vector<string> const &temps = node.getTemps();
+    Instructions const &args = node.getArgs();
+    for (size_t i = 0; i != args.size(); ++i) {
+        int value = dispatch(args[i]);
+        currentFrame().variables[temps[i]] = value;
+    }
+    return dispatch(node.getBody());
+}
+
+vector<int> &ExecutionContext::array(int handle, size_t lineNumber){
+    if (handle <= 0 || static_cast<size_t>(handle) > arrays.size())
+        throw RuntimeError("value is not an array", lineNumber);
+    return arrays[handle - 1];
+}
+
+int ExecutionContext::loadIndex(int handle, int index, size_t lineNumber){
+    vector<int> &values = array(handle, lineNumber);
+    if (index < 0 || static_cast<size_t>(index) >= values.size())
+        throw RuntimeError("array index out of bounds", lineNumber);
+    return values[index];
+}
+
+void ExecutionContext::storeIndex(int handle, int index, int value, size_t lineNumber){
+    vector<int> &values = array(handle, lineNumber);
+    if (index < 0 || static_cast<size_t>(index) >= values.size())
+        throw RuntimeError("array index out of bounds", lineNumber);
+    values[index] = value;
+}
+
+// Elements all the arrays of one run may hold together: 1 GB of ints.
+static const size_t maxArrayElements = 1 << 28;
+
+int ExecutionContext::arrayOp(ArrayOp::Operation op, int const *args, size_t lineNumber){
+    if (op == ArrayOp::NEW) {
+        if (args[0] < 0)
+            throw RuntimeError("negative array size", lineNumber);
+        if (arrays.size() >= static_cast<size_t>(INT_MAX))
+            throw RuntimeError("too many arrays", lineNumber);
+        if (static_cast<size_t>(args[0]) > maxArrayElements - arrayElements)
+            throw RuntimeError("arrays too large", lineNumber);
+        try {
+            arrays.push_back(vector<int>(args[0], 0));
+        } catch (std::bad_alloc const &) {
+            throw RuntimeError("out of memory", lineNumber);
+        }
+        arrayElements += args[0];
+        return arrays.size();
+    }
+
+    vector<int> &first = array(args[0], lineNumber);
+    size_t size = first.size();
+    switch (op) {
+    case ArrayOp::LEN:
+        return size;
+    case ArrayOp::SUM:
+        return sumKernel(first.data(), size);
+    case ArrayOp::FILL:
+        fillKernel(first.data(), size, args[1]);
+        return args[0];
+    case ArrayOp::COPY: {
+        vector<int> &source = array(args[1], lineNumber);
+        if (source.size() != size)
+            throw RuntimeError("array lengths differ", lineNumber);
+        copyKernel(first.data(), source.data(), size);
+        return args[0];
+    }
+    case ArrayOp::ADD:
+    case ArrayOp::MUL: {
+        vector<int> &x = array(args[1], lineNumber);
+        vector<int> &y = array(args[2], lineNumber);
+        if (x.size() != size || y.size() != size)
+            throw RuntimeError("array lengths differ", lineNumber);
+        if (op == ArrayOp::ADD) addKernel(first.data(), x.data(), y.data(), size);
+        else mulKernel(first.data(), x.data(), y.data(), size);
+        return args[0];
+    }
+    default:
+        throw RuntimeError(string("unknown built-in '") + ArrayOp::name(op) + "'", lineNumber);
+    }
+}
+
+size_t ExecutionContext::allocateRegisters(Bytecode const &code){
+    size_t base = registers.size();
+    registers.resize(base + code.slots.size() + code.maxStack);
+    defined.resize(base + code.slots.size() + code.maxStack, 0);
+    return base;
+}
+
+void ExecutionContext::releaseRegisters(size_t base){
+    registers.resize(base);
+    defined.resize(base);
+}
+
+// Moves the variables of the current frame into the slots of a compiled
+// loop, runs it from its condition, and moves them back.
+int ExecutionContext::runLoop(Bytecode const &code){
+    size_t base = allocateRegisters(code);
+    size_t frame = frames.size() - 1;
+    for (size_t i = 0; i != code.slots.size(); ++i) {
+        map<string, int> const &variables = frames[frame].variables;
+        map<string, int>::const_iterator it = variables.find(code.slots[i]);
+        if (it == variables.end()) continue;
+        registers[base + i] = it->second;
+        defined[base + i] = 1;
+    }
+
+    bool returned = false;
+    int value = runBytecode(code, base, returned);
+
+    Frame &current = frames[frame];
+    for (size_t i = 0; i != code.slots.size(); ++i)
+        if (defined[base + i]) current.variables[code.slots[i]] = registers[base + i];
+    if (returned) {
+        current.returned = true;
+        current.returnValue = value;
+    }
+    releaseRegisters(base);
+    return 0;
+}
+
+int ExecutionContext::runBytecode(Bytecode const &code, size_t base, bool &returned){
+    size_t const slotCount = code.slots.size();
+    Bytecode::Instr const *instructions = &code.code[0];
+    int *slots = registers.data() + base;
+    char *isDefined = defined.data() + base;
+    int *stack = slots + slotCount;
+    size_t sp = 0;
+    size_t pc = 0;
+
+    while (true) {
+        Bytecode::Instr const &instr = instructions[pc++];
+        switch (instr.op) {
+        case Bytecode::CONST:
+            stack[sp++] = instr.arg;
+            break;
+        case Bytecode::LOAD:
+            if (!isDefined[instr.arg])
+                throw RuntimeError("undefined variable '" + code.slots[instr.arg] + "'", instr.lineNumber);
+            stack[sp++] = slots[instr.arg];
+            break;
+        case Bytecode::STORE:
+            slots[instr.arg] = stack[--sp];
+            isDefined[instr.arg] = 1;
+            break;
+        case Bytecode::POP:
+            --sp;
+            break;
+        case Bytecode::ADD: --sp; stack[sp - 1] = add(stack[sp - 1], stack[sp]); break;
+        case Bytecode::SUB: --sp; stack[sp - 1] = subtract(stack[sp - 1], stack[sp]); break;
+        case Bytecode::MUL: --sp; stack[sp - 1] = multiply(stack[sp - 1], stack[sp]); break;
+        case Bytecode::DIV: --sp; stack[sp - 1] = divide(stack[sp - 1], stack[sp], instr.lineNumber); break;
+        case Bytecode::EQ: --sp; stack[sp - 1] = stack[sp - 1] == stack[sp]; break;
+        case Bytecode::NE: --sp; stack[sp - 1] = stack[sp - 1] != stack[sp]; break;
+        case Bytecode::LT: --sp; stack[sp - 1] = stack[sp - 1] < stack[sp]; break;
+        case Bytecode::GT: --sp; stack[sp - 1] = stack[sp - 1] > stack[sp]; break;
+        case Bytecode::LE: --sp; stack[sp - 1] = stack[sp - 1] <= stack[sp]; break;
+        case Bytecode::GE: --sp; stack[sp - 1] = stack[sp - 1] >= stack[sp]; break;
+        case Bytecode::JUMP:
+            pc = instr.arg;
+            break;
+        case Bytecode::JUMP_IF_FALSE:
+            if (!stack[--sp]) pc = instr.arg;
+            break;
+        case Bytecode::LOOP:
+            tick();
+            pc = instr.arg;
+            break;
+        case Bytecode::CALL: {
+            FunDef const &function = *code.calls[instr.arg].function;
+            size_t count = function.getParams().size();
+            sp -= count;
+            // The callee may grow the registers, so pass a copy of the arguments.
+            int small[8];
+            vector<int> large(count > 8 ? count : 0);
+            int *args = count > 8 ? &large[0] : small;
+            for (size_t i = 0; i != count; ++i) args[i] = stack[sp + i];
+            int res = call(function, args, instr.lineNumber);
+            slots = registers.data() + base;
+            isDefined = defined.data() + base;
+            stack = slots + slotCount;
+            stack[sp++] = res;
+            break;
+        }
+        case Bytecode::RETURN:
+            returned = true;
+            return stack[--sp];
+        case Bytecode::READ: {
+            int value = 0;
+            if (!io.read(value))
+                throw RuntimeError("no input for '" + code.slots[instr.arg] + "'", instr.lineNumber);
+            slots[instr.arg] = value;
+            isDefined[instr.arg] = 1;
+            break;
+        }
+        case Bytecode::PRINT:
+            io.print(stack[--sp]);
+            break;
+        case Bytecode::INDEX:
+            --sp;
+            stack[sp - 1] = loadIndex(stack[sp - 1], stack[sp], instr.lineNumber);
+            break;
+        case Bytecode::INDEX_STORE:
+            sp -= 3;
+            storeIndex(stack[sp], stack[sp + 1], stack[sp + 2], instr.lineNumber);
+            break;
+        case Bytecode::ARRAY: {
+            ArrayOp::Operation op = static_cast<ArrayOp::Operation>(instr.arg);
+            sp -= ArrayOp::arity(op);
+            stack[sp] = arrayOp(op, stack + sp, instr.lineNumber);
+            ++sp;
+            break;
+        }
+        case Bytecode::END:
+            returned = false;
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "runtimeError.h"
+#include "programContext.h"
+#include "staticVisitor.h"
+#include "inputOutput.h"
+#include "bytecode.h"
+#include "tiering.h"
+#include "loopIdioms.h"
+#include "trace.h"
+
+using std::map;
+using std::string;
+using std::vector;
+
+// Called by ExecutionContext once it has used up its instruction budget,
+// counted at While back-edges and FunCall entries.
+class Preemption {
+public:
+    virtual ~Preemption() {}
+
+    virtual void yield() = 0;
+};
+
+// Per-thread state of one run: the frame stack and the io callbacks.
+// The ProgramContext is only read, so any number of contexts can execute
+// the same program concurrently.
+class ExecutionContext: public StaticVisitor<ExecutionContext> {
+public:
+    ExecutionContext(ProgramContext const &program, InputOutput &io);
+
+    int run();
+
+    // Runs one top-level statement in the global frame, which persists
+    // between calls. Returns false once a top-level return ended the program.
+    bool executeTopLevel(Instruction const &instruction);
+
+    void setPreemption(Preemption *preemption, unsigned budget);
+
+    // Lowest native stack address a run may use, for a stack the caller
+    // allocated itself. By default each run derives it from RLIMIT_STACK
+    // and the frame it starts in.
+    void setStackLimit(void const *limit){
+        stackBottom = static_cast<char const *>(limit);
+    }
+
+    // Size of the native stack of the thread that runs, when it is not
+    // the one RLIMIT_STACK gives; 0 restores that default.
+    void setStackSize(size_t size){
+        stackSize = size;
+    }
+
+    // Lets hot defs and loops run as Bytecode; null keeps the AST tier only.
+    void setTiering(TierManager *tiering){
+        this->tiering = tiering;
+    }
+
+    // Records calls, branches and io into trace; null stops recording.
+    // Bytecode records nothing, so a traced run should not use tiering.
+    void setTrace(TraceBuffer *trace){
+        this->trace = trace;
+    }
+
+    int visit(Program const &node);
+    int visit(FunDef const &node);
+    int visit(VarDef const &node);
+    int visit(Num const &node);
+    int visit(Var const &node);
+    int visit(FunCall const &node);
+    int visit(Operator const &node);
+    int visit(Cond const &node);
+    int visit(If const &node);
+    int visit(While const &node);
+    int visit(Return const &node);
+    int visit(Read const &node);
+    int visit(Print const &node);
+    int visit(Index const &node);
+    int visit(IndexAssign const &node);
+    int visit(ArrayOp const &node);
+    int visit(InlinedCall const &node);
+
+private:
+    struct Frame {
+        map<string, int> variables;
+        bool returned;
+        int returnValue;
+
+        Frame(): returned(false), returnValue(0) {}
+    };
+
+    ProgramContext const &program;
+    InputOutput &io;
+    vector<Frame> frames;
+    char const *stackBottom;
+    size_t stackSize;
+    char const *stackLimit;
+
+    Preemption *preemption;
+    unsigned budget;
+    unsigned remainingBudget;
+
+    TierManager *tiering;
+    TraceBuffer *trace;
+    // Slots and operand stacks of Bytecode frames, one region per call.
+    vector<int> registers;
+    vector<char> defined;
+    // Arrays created by this run; a handle is an index plus one. They live
+    // until the run ends, so their total size is capped.
+    vector<vector<int> > arrays;
+    size_t arrayElements;
+
+    void tick(){
+        if (--remainingBudget == 0) budgetExhausted();
+    }
+
+    void budgetExhausted();
+
+    Frame &currentFrame(){
+        return frames.back();
+    }
+
+    // Calls and operators nest on the native stack, which grows down.
+    void checkStack(size_t lineNumber){
+        char here;
+        if (reinterpret_cast<uintptr_t>(&here) < reinterpret_cast<uintptr_t>(stackLimit))
+            throw RuntimeError("call stack overflow", lineNumber);
+    }
+
+    void limitStack();
+
+    bool execute(Instructions const &instructions);
+    int lookup(string const &name, size_t lineNumber);
+    vector<int> &array(int handle, size_t lineNumber);
+    int loadIndex(int handle, int index, size_t lineNumber);
+    void storeIndex(int handle, int index, int value, size_t lineNumber);
+    int arrayOp(ArrayOp::Operation op, int const *args, size_t lineNumber);
+    int call(FunDef const &function, int const *args, size_t lineNumber);
+    bool runIdiom(LoopIdiom const &idiom);
+    bool reduceInParallel(LoopIdiom const &idiom, int first, long long count, unsigned &total);
+    unsigned reduce(LoopIdiom const &idiom, int first, long long count);
+
+    // Iterations of a parallel reduction given to one thread.
+    struct Chunk {
+        int first;
+        long long count;
+        unsigned total;
+        bool failed;
+
+        Chunk(): first(0), count(0), total(0), failed(false) {}
+    };
+
+    void reduceChunk(LoopIdiom const *idiom, Chunk *chunk);
+    int runLoop(Bytecode const &code);
+    int runBytecode(Bytecode const &code, size_t base, bool &returned);
+    size_t allocateRegisters(Bytecode const &code);
+    void releaseRegisters(size_t base);
+
+    ExecutionContext(ExecutionContext const &);
+    ExecutionContext &operator=(ExecutionContext const &);
+};
+
+#endif // INTERPRETER_H
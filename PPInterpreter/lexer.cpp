@@ -1,26 +1,54 @@
 #include "lexer.h"
 
+// Tokens are read ahead into a queue instead of seeking the stream back
+// after each look, which costs a buffer refill on file streams.
 bool Lexer::checkToken(Token::Type t, size_t steps){
-    Token token;
-    int position = sourceStream.tellg();
-    int curLine = currentLine;
-    for (size_t i = 0; i != steps; ++i)
-        token = nextToken();
-    sourceStream.seekg(position);
-    currentLine = curLine;
-    return (token.type == t);
+    while (lookahead.size() < steps) readAhead();
+    return lookahead[steps - 1].token.type == t;
 }
 
 Token Lexer::nextToken(){
-    char peek = sourceStream.get();
-    while (sourceStream && isspace(peek) && peek != '\n') peek = sourceStream.get();
+    if (lookahead.empty()) readAhead();
+    Lookahead next = lookahead.front();
+    lookahead.pop_front();
+    currentLine = next.line;
+    offset = next.offset;
+    return next.token;
+}
+
+void Lexer::lexAll(){
+    while (lookahead.empty() || lookahead.back().token.type != Token::Eof) readAhead();
+}
+
+void Lexer::readAhead(){
+    Lookahead next;
+    next.token = lex();
+    next.line = lexLine;
+    next.offset = lexOffset;
+    lookahead.push_back(next);
+}
+
+char Lexer::get(){
+    char c = sourceStream.get();
+    if (sourceStream) ++lexOffset;
+    return c;
+}
+
+void Lexer::putback(char c){
+    if (sourceStream.putback(c)) --lexOffset;
+}
+
+Token Lexer::lex(){
+    char peek = get();
+    while (sourceStream && isspace(peek) && peek != '\n') peek = get();
 
     if (!sourceStream) return Token::Eof;
 
     if (peek == '#')
-        while (peek != '\n')
-            peek = sourceStream.get();
-    sourceStream.putback(peek);
+        while (sourceStream && peek != '\n')
+            peek = get();
+    if (!sourceStream) return Token::Eof;
+    putback(peek);
 
     Token res = getSymbol();
     if (res.type == Token::WTF)
@@ -31,17 +59,17 @@ Token Lexer::nextToken(){
 }
 
 Token Lexer::getIdentifier(){
-    char peek = sourceStream.get();
+    char peek = get();
 
     if (!isalpha(peek)){
-        sourceStream.putback(peek);
+        putback(peek);
         return Token::WTF;
     }
 
     string temp;
     temp.push_back(peek);
     while (isalpha(sourceStream.peek()) || isdigit(peek) || peek == '_')
-        temp.push_back(sourceStream.get());
+        temp.push_back(get());
 
     if (temp == "def")
         return Token::DEF;
@@ -61,24 +89,24 @@ Token Lexer::getIdentifier(){
 }
 
 Token Lexer::getNumber(){
-    char peek = sourceStream.get();
+    char peek = get();
 
     if (!isdigit(peek)){
-        sourceStream.putback(peek);
+        putback(peek);
         return Token::WTF;
     }
 
     string number;
     number.push_back(peek);
     while (isdigit(sourceStream.peek()))
-        number.push_back(sourceStream.get());
+        number.push_back(get());
 
     long num = atol(number.c_str());
     return Token(Token::NUM, num);
 }
 
 Token Lexer::getSymbol(){
-    char peek = sourceStream.get();
+    char peek = get();
     char next = 0;
 
     switch (peek) {
@@ -86,6 +114,10 @@ Token Lexer::getSymbol(){
         return Token::LP;
     case ')':
         return Token::RP;
+    case '[':
+        return Token::LB;
+    case ']':
+        return Token::RB;
     case '+':
         return Token::PLUS;
     case '-':
@@ -99,43 +131,43 @@ Token Lexer::getSymbol(){
     case ',':
         return Token::COM;
     case '\n':
-        ++currentLine;
+        ++lexLine;
         return Token::CR;
     case '=':
-        next = sourceStream.get();
+        next = get();
         if (next == '=') {
             return Token::EQ;
         } else {
-            sourceStream.putback(next);
+            putback(next);
             return Token::ASGN;
         }
     case '!':
-        next = sourceStream.get();
+        next = get();
         if (next == '=') {
             return Token::NE;
         } else {
             return Token::WTF;
         }
     case '>': {
-        next = sourceStream.get();
+        next = get();
         if (next == '=') {
             return Token::GE;
         } else {
-            sourceStream.putback(next);
+            putback(next);
             return Token::GT;
         }
     }
     case '<': {
-        next = sourceStream.get();
+        next = get();
         if (next == '=') {
             return Token::LE;
         } else {
-            sourceStream.putback(next);
+            putback(next);
             return Token::LT;
         }
     }
     default:{
-        sourceStream.putback(peek);
+        putback(peek);
         return Token::WTF;
     }
     }
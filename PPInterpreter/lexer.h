@@ -1,6 +1,7 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <deque>
 #include <string>
 #include <iostream>
 #include <cctype>
@@ -8,6 +9,7 @@
 #include <cstdio>
 #include "Token.h"
 
+using std::deque;
 using std::string;
 using std::istream;
 
@@ -16,19 +18,47 @@ struct Lexer{
     size_t currentLine;
 
 public:
-    Lexer(istream &sourceStream):
+    Lexer(istream &sourceStream, size_t firstLine = 1):
         sourceStream(sourceStream),
-        currentLine(1)
+        currentLine(firstLine),
+        offset(0),
+        lexLine(firstLine),
+        lexOffset(0)
     {}
 
     Token nextToken();
     bool checkToken(Token::Type t, size_t steps = 1);
+    // Reads the rest of the source ahead, so that later calls only take
+    // tokens from the queue.
+    void lexAll();
 
     size_t getLineNumber() const{
         return currentLine;
     }
 
+    // Characters consumed by nextToken() since the lexer was created.
+    size_t getOffset() const{
+        return offset;
+    }
+
 private:
+    // A token read ahead by checkToken(), with the line and offset that
+    // become current once nextToken() returns it.
+    struct Lookahead {
+        Token token;
+        size_t line;
+        size_t offset;
+    };
+
+    deque<Lookahead> lookahead;
+    size_t offset;
+    size_t lexLine;
+    size_t lexOffset;
+
+    void readAhead();
+    Token lex();
+    char get();
+    void putback(char c);
     Token getIdentifier();
     Token getNumber();
     Token getSymbol();
@@ -0,0 +1,362 @@
+#include <set>
+#include "loopIdioms.h"
+
+using std::set;
+
+// Highest power of the counter a closed-form term may contain.
+static int const maxDegree = 4;
+
+static bool isVar(InstructionPtr const &node, string const &name){
+    return node && node->getKind() == Instruction::VAR && static_cast<Var const &>(*node).getName() == name;
+}
+
+static bool isNum(InstructionPtr const &node, int value){
+    return node && node->getKind() == Instruction::NUM && static_cast<Num const &>(*node).getValue() == value;
+}
+
+static bool reads(Instruction const &node, string const &name);
+
+static bool readsAny(Instructions const &nodes, string const &name){
+    for (size_t i = 0; i != nodes.size(); ++i)
+        if (!nodes[i] || reads(*nodes[i], name)) return true;
+    return false;
+}
+
+// Conservative: true for anything it cannot see through.
+static bool reads(Instruction const &node, string const &name){
+    switch (node.getKind()) {
+    case Instruction::NUM:
+        return false;
+    case Instruction::VAR:
+        return static_cast<Var const &>(node).getName() == name;
+    case Instruction::OPERATOR: {
+        Operator const &op = static_cast<Operator const &>(node);
+        return !op.getLeft() || !op.getRight() || reads(*op.getLeft(), name) || reads(*op.getRight(), name);
+    }
+    case Instruction::COND: {
+        Cond const &cond = static_cast<Cond const &>(node);
+        return !cond.getLeft() || !cond.getRight() || reads(*cond.getLeft(), name) || reads(*cond.getRight(), name);
+    }
+    case Instruction::FUN_CALL:
+        return readsAny(static_cast<FunCall const &>(node).getParams(), name);
+    case Instruction::INLINED_CALL: {
+        InlinedCall const &call = static_cast<InlinedCall const &>(node);
+        return readsAny(call.getArgs(), name) || !call.getBody() || reads(*call.getBody(), name);
+    }
+    default:
+        return true;
+    }
+}
+
+// Degree of node as a polynomial in counter, or -1 if it is not one.
+// temps holds the degrees of the args of enclosing inlined calls.
+static int degree(Instruction const &node, string const &counter, map<string, int> &temps){
+    switch (node.getKind()) {
+    case Instruction::NUM:
+        return 0;
+    case Instruction::VAR: {
+        string const &name = static_cast<Var const &>(node).getName();
+        map<string, int>::const_iterator it = temps.find(name);
+        if (it != temps.end()) return it->second;
+        return name == counter ? 1 : 0;
+    }
+    case Instruction::INLINED_CALL: {
+        InlinedCall const &call = static_cast<InlinedCall const &>(node);
+        for (size_t i = 0; i != call.getArgs().size(); ++i) {
+            int power = call.getArgs()[i] ? degree(*call.getArgs()[i], counter, temps) : -1;
+            if (power < 0) return -1;
+            temps[call.getTemps()[i]] = power;
+        }
+        return call.getBody() ? degree(*call.getBody(), counter, temps) : -1;
+    }
+    case Instruction::OPERATOR: {
+        Operator const &op = static_cast<Operator const &>(node);
+        if (!op.getLeft() || !op.getRight()) return -1;
+        int left = degree(*op.getLeft(), counter, temps);
+        int right = degree(*op.getRight(), counter, temps);
+        if (left < 0 || right < 0) return -1;
+        switch (op.getOperation()) {
+        case '+':
+        case '-': return left > right ? left : right;
+        case '*': return left + right;
+        default: return -1;
+        }
+    }
+    default:
+        return -1;
+    }
+}
+
+static bool isPure(FunDef const &function, ProgramContext const &program, set<FunDef const *> &visiting);
+
+static bool isPure(Instruction const &node, ProgramContext const &program, set<FunDef const *> &visiting);
+
+static bool allPure(Instructions const &nodes, ProgramContext const &program, set<FunDef const *> &visiting){
+    for (size_t i = 0; i != nodes.size(); ++i)
+        if (!nodes[i] || !isPure(*nodes[i], program, visiting)) return false;
+    return true;
+}
+
+// Pure code only reads its own frame: no io, no arrays, and only calls
+// to pure defs with the right number of arguments.
+static bool isPure(Instruction const &node, ProgramContext const &program, set<FunDef const *> &visiting){
+    switch (node.getKind()) {
+    case Instruction::NUM:
+    case Instruction::VAR:
+        return true;
+    case Instruction::VAR_DEF:
+        return static_cast<VarDef const &>(node).getExp() && isPure(*static_cast<VarDef const &>(node).getExp(), program, visiting);
+    case Instruction::RETURN:
+        return static_cast<Return const &>(node).getExp() && isPure(*static_cast<Return const &>(node).getExp(), program, visiting);
+    case Instruction::OPERATOR: {
+        Operator const &op = static_cast<Operator const &>(node);
+        return op.getLeft() && op.getRight() && isPure(*op.getLeft(), program, visiting) && isPure(*op.getRight(), program, visiting);
+    }
+    case Instruction::COND: {
+        Cond const &cond = static_cast<Cond const &>(node);
+        return cond.getLeft() && cond.getRight() && isPure(*cond.getLeft(), program, visiting) && isPure(*cond.getRight(), program, visiting);
+    }
+    case Instruction::IF: {
+        If const &branch = static_cast<If const &>(node);
+        return branch.getCond() && isPure(*branch.getCond(), program, visiting) && allPure(branch.getInstructions(), program, visiting);
+    }
+    case Instruction::WHILE: {
+        While const &loop = static_cast<While const &>(node);
+        return loop.getCond() && isPure(*loop.getCond(), program, visiting) && allPure(loop.getInstructions(), program, visiting);
+    }
+    case Instruction::FUN_CALL: {
+        FunCall const &call = static_cast<FunCall const &>(node);
+        map<string, FunPtr>::const_iterator it = program.functions.find(call.getName());
+        if (it == program.functions.end() || it->second->getParams().size() != call.getParams().size()) return false;
+        return allPure(call.getParams(), program, visiting) && isPure(*it->second, program, visiting);
+    }
+    case Instruction::INLINED_CALL: {
+        InlinedCall const &call = static_cast<InlinedCall const &>(node);
+        return allPure(call.getArgs(), program, visiting) && call.getBody() && isPure(*call.getBody(), program, visiting);
+    }
+    default:
+        return false;
+    }
+}
+
+static bool isPure(FunDef const &function, ProgramContext const &program, set<FunDef const *> &visiting){
+    if (!function.isParsed()) return false;
+    // A recursive call is pure if the rest of the body is.
+    if (!visiting.insert(&function).second) return true;
+    return allPure(function.getInstructions(), program, visiting);
+}
+
+bool isPureTerm(LoopIdiom const &idiom, ProgramContext const &program){
+    set<FunDef const *> visiting;
+    return isPure(*idiom.term, program, visiting);
+}
+
+static bool callsAny(Instruction const &node){
+    switch (node.getKind()) {
+    case Instruction::FUN_CALL:
+        return true;
+    case Instruction::OPERATOR:
+        return callsAny(*static_cast<Operator const &>(node).getLeft()) || callsAny(*static_cast<Operator const &>(node).getRight());
+    case Instruction::COND:
+        return callsAny(*static_cast<Cond const &>(node).getLeft()) || callsAny(*static_cast<Cond const &>(node).getRight());
+    case Instruction::INLINED_CALL: {
+        InlinedCall const &call = static_cast<InlinedCall const &>(node);
+        for (size_t i = 0; i != call.getArgs().size(); ++i)
+            if (callsAny(*call.getArgs()[i])) return true;
+        return callsAny(*call.getBody());
+    }
+    default:
+        return false;
+    }
+}
+
+static shared_ptr<LoopIdiom const> match(While const &loop, ProgramContext const &program){
+    shared_ptr<LoopIdiom const> none;
+    if (!loop.getCond() || loop.getCond()->getKind() != Instruction::COND) return none;
+    Cond const &cond = static_cast<Cond const &>(*loop.getCond());
+    if (cond.getComparison() != "<" && cond.getComparison() != "<=") return none;
+    if (!cond.getLeft() || cond.getLeft()->getKind() != Instruction::VAR || !cond.getRight()) return none;
+    if (cond.getRight()->getKind() != Instruction::VAR && cond.getRight()->getKind() != Instruction::NUM) return none;
+
+    Instructions const &body = loop.getInstructions();
+    if (body.size() != 2 || !body[0] || !body[1]) return none;
+    if (body[0]->getKind() != Instruction::VAR_DEF || body[1]->getKind() != Instruction::VAR_DEF) return none;
+
+    shared_ptr<LoopIdiom> idiom(new LoopIdiom());
+    idiom->counter = static_cast<Var const &>(*cond.getLeft()).getName();
+    idiom->bound = cond.getRight();
+    idiom->inclusive = cond.getComparison() == "<=";
+
+    VarDef const &step = static_cast<VarDef const &>(*body[1]);
+    if (step.getName() != idiom->counter || !step.getExp() || step.getExp()->getKind() != Instruction::OPERATOR) return none;
+    Operator const &increment = static_cast<Operator const &>(*step.getExp());
+    if (increment.getOperation() != '+') return none;
+    if (!(isVar(increment.getLeft(), idiom->counter) && isNum(increment.getRight(), 1)) &&
+        !(isNum(increment.getLeft(), 1) && isVar(increment.getRight(), idiom->counter))) return none;
+
+    VarDef const &update = static_cast<VarDef const &>(*body[0]);
+    idiom->accumulator = update.getName();
+    if (idiom->accumulator == idiom->counter || isVar(idiom->bound, idiom->accumulator) || isVar(idiom->bound, idiom->counter)) return none;
+    if (!update.getExp() || update.getExp()->getKind() != Instruction::OPERATOR) return none;
+    Operator const &sum = static_cast<Operator const &>(*update.getExp());
+    if (sum.getOperation() == '+' && isVar(sum.getLeft(), idiom->accumulator)) idiom->term = sum.getRight();
+    else if (sum.getOperation() == '+' && isVar(sum.getRight(), idiom->accumulator)) idiom->term = sum.getLeft();
+    else if (sum.getOperation() == '-' && isVar(sum.getLeft(), idiom->accumulator)) idiom->term = sum.getRight();
+    else return none;
+    idiom->subtract = sum.getOperation() == '-';
+    if (!idiom->term || reads(*idiom->term, idiom->accumulator)) return none;
+
+    map<string, int> temps;
+    int power = degree(*idiom->term, idiom->counter, temps);
+    if (power >= 0 && power <= maxDegree) {
+        idiom->kind = LoopIdiom::CLOSED_FORM;
+        return idiom;
+    }
+    if (callsAny(*idiom->term) && isPureTerm(*idiom, program)) {
+        idiom->kind = LoopIdiom::PARALLEL;
+        return idiom;
+    }
+    return none;
+}
+
+static void recognizeAll(Instructions const &nodes, ProgramContext const &program){
+    for (size_t i = 0; i != nodes.size(); ++i)
+        if (nodes[i]) recognizeLoopIdioms(*nodes[i], program);
+}
+
+void recognizeLoopIdioms(Instruction &node, ProgramContext const &program){
+    switch (node.getKind()) {
+    case Instruction::PROGRAM:
+    case Instruction::IF:
+        recognizeAll(static_cast<InstructionList &>(node).getInstructions(), program);
+        break;
+    case Instruction::FUN_DEF: {
+        FunDef &function = static_cast<FunDef &>(node);
+        if (function.isParsed()) recognizeAll(function.getInstructions(), program);
+        break;
+    }
+    case Instruction::WHILE: {
+        While &loop = static_cast<While &>(node);
+        loop.setIdiom(match(loop, program));
+        recognizeAll(loop.getInstructions(), program);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void recognizeLoopIdioms(ProgramContext const &program){
+    if (program.entryPoint) recognizeLoopIdioms(*program.entryPoint, program);
+    for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it)
+        recognizeLoopIdioms(*it->second, program);
+}
+
+namespace {
+
+// Coefficients of a polynomial in k = i - first, modulo 2^32.
+struct Polynomial {
+    unsigned c[maxDegree + 1];
+
+    explicit Polynomial(unsigned constant = 0){
+        for (int j = 0; j <= maxDegree; ++j) c[j] = 0;
+        c[0] = constant;
+    }
+};
+
+}
+
+static bool expand(Instruction const &node, LoopIdiom const &idiom, map<string, int> const &variables, int first,
+                   map<string, Polynomial> &temps, Polynomial &res){
+    if (node.getKind() == Instruction::NUM) {
+        res = Polynomial(static_cast<Num const &>(node).getValue());
+        return true;
+    }
+    if (node.getKind() == Instruction::VAR) {
+        string const &name = static_cast<Var const &>(node).getName();
+        map<string, Polynomial>::const_iterator temp = temps.find(name);
+        if (temp != temps.end()) {
+            res = temp->second;
+            return true;
+        }
+        map<string, int>::const_iterator it = variables.find(name);
+        if (it == variables.end()) return false;
+        if (name == idiom.counter) {
+            res = Polynomial(first);
+            res.c[1] = 1;
+        } else {
+            res = Polynomial(it->second);
+        }
+        return true;
+    }
+    if (node.getKind() == Instruction::INLINED_CALL) {
+        InlinedCall const &call = static_cast<InlinedCall const &>(node);
+        for (size_t i = 0; i != call.getArgs().size(); ++i) {
+            Polynomial arg;
+            if (!expand(*call.getArgs()[i], idiom, variables, first, temps, arg)) return false;
+            temps[call.getTemps()[i]] = arg;
+        }
+        return expand(*call.getBody(), idiom, variables, first, temps, res);
+    }
+
+    Operator const &op = static_cast<Operator const &>(node);
+    Polynomial left, right;
+    if (!expand(*op.getLeft(), idiom, variables, first, temps, left) || !expand(*op.getRight(), idiom, variables, first, temps, right)) return false;
+    res = Polynomial();
+    for (int i = 0; i <= maxDegree; ++i) {
+        switch (op.getOperation()) {
+        case '+': res.c[i] = left.c[i] + right.c[i]; break;
+        case '-': res.c[i] = left.c[i] - right.c[i]; break;
+        default:
+            // recognizeLoopIdioms() bounded the degree of the product.
+            for (int j = 0; i + j <= maxDegree; ++j)
+                res.c[i + j] += left.c[i] * right.c[j];
+        }
+    }
+    return true;
+}
+
+static unsigned long long multiplyMod(unsigned long long a, unsigned long long b, unsigned long long m){
+    // a, b < m < 2^39: split b so that no partial product overflows.
+    unsigned long long high = (a * (b >> 20)) % m;
+    return ((high << 20) + a * (b & 0xFFFFF)) % m;
+}
+
+// C(n, r) modulo 2^32. The product of r consecutive integers is r! times
+// the binomial, so it is reduced modulo r! * 2^32 and then divided by r!.
+static unsigned binomial(unsigned long long n, int r){
+    unsigned long long factorial = 1;
+    for (int i = 2; i <= r; ++i) factorial *= i;
+    unsigned long long m = factorial << 32;
+    unsigned long long product = 1 % m;
+    for (int i = 0; i != r; ++i) {
+        if (n < static_cast<unsigned long long>(i)) return 0;
+        product = multiplyMod(product, (n - i) % m, m);
+    }
+    return static_cast<unsigned>(product / factorial);
+}
+
+bool sumPolynomial(LoopIdiom const &idiom, map<string, int> const &variables, int first, long long count, unsigned &total){
+    // k^j = sum over m of S(j, m) * m! * C(k, m), with S the Stirling
+    // numbers of the second kind, and C(k, m) summed over k < count is
+    // C(count, m + 1).
+    static unsigned const stirling[maxDegree + 1][maxDegree + 1] = {
+        {1, 0, 0, 0, 0},
+        {0, 1, 0, 0, 0},
+        {0, 1, 2, 0, 0},
+        {0, 1, 6, 6, 0},
+        {0, 1, 14, 36, 24}
+    };
+
+    Polynomial term;
+    map<string, Polynomial> temps;
+    if (!expand(*idiom.term, idiom, variables, first, temps, term)) return false;
+    total = 0;
+    for (int m = 0; m <= maxDegree; ++m) {
+        unsigned weight = 0;
+        for (int j = m; j <= maxDegree; ++j)
+            weight += term.c[j] * stirling[j][m];
+        if (weight) total += weight * binomial(count, m + 1);
+    }
+    return true;
+}
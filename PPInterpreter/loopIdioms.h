@@ -0,0 +1,56 @@
+#ifndef LOOPIDIOMS_H
+#define LOOPIDIOMS_H
+
+#include <map>
+#include <string>
+#include "ast.h"
+#include "programContext.h"
+
+using std::map;
+using std::string;
+
+// A While loop of the form
+//
+//     while i < n:        (or i <= n; n is a number or a variable)
+//         s = s + term    (or term + s, or s - term)
+//         i = i + 1
+//     end
+//
+// where term does not read s. ExecutionContext runs it without iterating:
+// the final s is the wrap-around sum of term over every i, and i ends at
+// the first value that fails the condition.
+struct LoopIdiom {
+    enum Kind{
+        // term is a polynomial in i built from +, - and *, so the sum
+        // has a closed form.
+        CLOSED_FORM,
+        // term calls only pure defs, so ranges of i can be summed on
+        // separate threads.
+        PARALLEL
+    };
+
+    Kind kind;
+    string counter;
+    string accumulator;
+    InstructionPtr bound;
+    bool inclusive;
+    bool subtract;
+    InstructionPtr term;
+};
+
+// Attaches a LoopIdiom to every matching While in the program. Bodies of
+// defs that are not parsed yet are skipped.
+void recognizeLoopIdioms(ProgramContext const &program);
+// Same for one statement or def, e.g. while streaming.
+void recognizeLoopIdioms(Instruction &node, ProgramContext const &program);
+
+// Whether the term of a PARALLEL idiom still calls only pure defs. While
+// streaming, a later def may replace one that was pure when the loop was
+// recognized.
+bool isPureTerm(LoopIdiom const &idiom, ProgramContext const &program);
+
+// Sum of a CLOSED_FORM term over count values of the counter starting at
+// first, modulo 2^32. Returns false if the term reads an undefined variable.
+bool sumPolynomial(LoopIdiom const &idiom, map<string, int> const &variables, int first, long long count, unsigned &total);
+
+#endif // LOOPIDIOMS_H
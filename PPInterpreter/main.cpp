@@ -1,28 +1,209 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <iterator>
-#include "parser.h"
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "cppEmitter.h"
+#include "engine.h"
+#include "stats.h"
 
+using std::cin;
 using std::cout;
+using std::cerr;
 using std::endl;
 using std::ifstream;
+using std::ofstream;
 using std::istream_iterator;
+using std::istringstream;
+using std::string;
+using std::vector;
+
+// Writes the program as C++ to target, or to stdout for "-".
+static bool writeCpp(ProgramContext const &program, char const *sourceName, string const &target){
+    if (target == "-") {
+        emitCpp(program, sourceName, cout);
+        return true;
+    }
+    ofstream out(target.c_str());
+    if (!out.good()) {
+        cout << "Cannot write " << target << endl;
+        return false;
+    }
+    emitCpp(program, sourceName, out);
+    return out.good();
+}
+
+static int usage(char const *program){
+    cout << "Usage: " << program << " [--stats] [--stream] [--lazy] [--no-tier] [--no-idioms] [--inline-budget <NODES>] [--tier-debug]"
+         << " [--emit-cpp <OUT.cpp|->] [--build-native <EXE>] [--trace <OUT>] <SOURCE_FILE_NAME>" << endl;
+    return 1;
+}
+
+// Whole decimal number from 0 to INT_MAX.
+static bool parseCount(char const *text, size_t &value){
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end || errno == ERANGE || parsed < 0 || parsed > INT_MAX) return false;
+    value = parsed;
+    return true;
+}
+
+// Compiles source into the executable target with $CXX, default c++,
+// which may carry its own flags. Arguments go to the compiler as they
+// are, without a shell, so paths need no quoting.
+static bool compileNative(string const &source, string const &target){
+    char const *compiler = getenv("CXX");
+    istringstream words(compiler && *compiler ? compiler : "c++");
+    vector<string> command;
+    string word;
+    while (words >> word) command.push_back(word);
+    command.push_back("-O2");
+    command.push_back("-o");
+    command.push_back(target);
+    command.push_back(source);
+
+    vector<char *> argv;
+    for (size_t i = 0; i != command.size(); ++i) argv.push_back(const_cast<char *>(command[i].c_str()));
+    argv.push_back(0);
+#ifdef _WIN32
+    return _spawnvp(_P_WAIT, argv[0], &argv[0]) == 0;
+#else
+    pid_t child = fork();
+    if (child == -1) return false;
+    if (child == 0) {
+        execvp(argv[0], &argv[0]);
+        _exit(127);
+    }
+    int status;
+    while (waitpid(child, &status, 0) == -1)
+        if (errno != EINTR) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
 
 int main(int args, char const *argv[])
 {
-    if (args < 2){
-        cout << "Usage: " << argv[0] << " <SOURCE_FILE_NAME>" << endl;
-        return 1;
+    bool stats = false;
+    bool stream = false;
+    bool inlineBudget = false;
+    CompileOptions options;
+    bool tier = true;
+    bool tierDebug = false;
+    char const *emitTarget = 0;
+    char const *nativeTarget = 0;
+    char const *traceFile = 0;
+    char const *fileName = 0;
+    for (int i = 1; i < args; ++i) {
+        if (string(argv[i]) == "--emit-cpp" && i + 1 < args) emitTarget = argv[++i];
+        else if (string(argv[i]) == "--build-native" && i + 1 < args) nativeTarget = argv[++i];
+        else if (string(argv[i]) == "--trace" && i + 1 < args) traceFile = argv[++i];
+        else if (string(argv[i]) == "--stats") stats = true;
+        else if (string(argv[i]) == "--stream") stream = true;
+        else if (string(argv[i]) == "--lazy") options.lazyFunctions = true;
+        else if (string(argv[i]) == "--no-tier") tier = false;
+        else if (string(argv[i]) == "--no-idioms") options.loopIdioms = false;
+        else if (string(argv[i]) == "--inline-budget" && i + 1 < args) {
+            if (!parseCount(argv[++i], options.inlineBudget)) return usage(argv[0]);
+            inlineBudget = true;
+        }
+        else if (string(argv[i]) == "--tier-debug") tierDebug = true;
+        else fileName = argv[i];
     }
 
-    ifstream in(argv[1]);
+    if (!fileName) return usage(argv[0]);
+    // Streaming never tiers, so --no-tier changes nothing there.
+    if (stream && (options.lazyFunctions || inlineBudget)) {
+        cout << "--lazy and --inline-budget cannot be combined with --stream" << endl;
+        return usage(argv[0]);
+    }
+    // Nothing runs when emitting, so there is nothing to stream, trace or measure.
+    if ((emitTarget || nativeTarget) && (stream || traceFile || stats)) {
+        cout << "--stream, --trace and --stats cannot be combined with --emit-cpp or --build-native" << endl;
+        return usage(argv[0]);
+    }
+
+    ifstream in(fileName);
     if(!in.good()){
-        cout << "File " << argv[1] << " does not exist" << endl;
+        cout << "File " << fileName << " does not exist" << endl;
         in.close();
         return 2;
     }
-    in >> std::noskipws;
-    Parser parser(in);
-    ProgramContext pc = parser.parse();
-    return 0;
+
+    if (emitTarget || nativeTarget) {
+        try {
+            CompiledProgram program = compileProgram(in, options);
+            if (emitTarget && !writeCpp(*program, fileName, emitTarget)) return 4;
+            if (nativeTarget) {
+                string source = string(nativeTarget) + ".cpp";
+                if (!writeCpp(*program, fileName, source)) return 4;
+                if (!compileNative(source, nativeTarget)) {
+                    cout << "Native build of " << nativeTarget << " failed" << endl;
+                    return 4;
+                }
+            }
+        } catch (RuntimeError const &e) {
+            cerr << fileName << ":" << e.getLineNumber() << ": " << e.what() << endl;
+            return 3;
+        }
+        return 0;
+    }
+
+    // Inlined calls would leave no trace, so a traced run keeps every call.
+    shared_ptr<TraceRecorder> recorder;
+    RunOptions run;
+    if (traceFile) {
+        options.inlineBudget = 0;
+        recorder = createTrace(traceFile);
+        if (!recorder) {
+            cout << "Cannot write " << traceFile << endl;
+            return 4;
+        }
+        run.trace = recorder.get();
+    }
+
+    Stats *phaseStats = stats ? new Stats() : 0;
+    StreamInputOutput io(cin, cout);
+    int res = 0;
+    try {
+        if (stream) {
+            // Parsing and execution interleave, so they share one phase.
+            if (phaseStats) phaseStats->beginPhase("stream");
+            runStreaming(in, io, options, run);
+        } else {
+            CompiledProgram program = compileProgram(in, options, phaseStats);
+            if (phaseStats) {
+                phaseStats->countNodes(*program);
+                phaseStats->beginPhase("execute");
+            }
+            shared_ptr<TierManager> tiering;
+            if (tier) tiering = createTiering(1000, 1000, tierDebug ? &cerr : 0);
+            run.tiering = tiering.get();
+            runProgram(program, io, run);
+        }
+    } catch (RuntimeError const &e) {
+        cout.flush();
+        cerr << fileName << ":" << e.getLineNumber() << ": " << e.what() << endl;
+        res = 3;
+    }
+
+    if (phaseStats) {
+        cout.flush();
+        phaseStats->endPhase();
+        phaseStats->write(cerr);
+        delete phaseStats;
+    }
+    // Writes out the rest of the trace.
+    recorder.reset();
+    return res;
 }
@@ -1,23 +1,148 @@
+#include <sstream>
 #include "parser.h"
+#include "runtimeError.h"
+
+using std::istringstream;
+
+namespace {
+
+struct SourceRange: public LazyBody {
+    SourceRange(shared_ptr<string const> const &source, size_t begin, size_t end, size_t firstLine):
+        source(source),
+        begin(begin),
+        end(end),
+        firstLine(firstLine)
+    {}
+
+    Instructions parse() const{
+        istringstream in(source->substr(begin, end - begin));
+        in >> std::noskipws;
+        Parser parser(in, firstLine);
+        return parser.parseBody();
+    }
+
+private:
+    shared_ptr<string const> source;
+    size_t begin;
+    size_t end;
+    size_t firstLine;
+};
+
+// Operands and operators of one parenthesis level of an expression, in
+// source order; operators[i] and lines[i] follow operands[i].
+struct ExpressionLevel {
+    explicit ExpressionLevel(size_t negations = 0):
+        negations(negations)
+    {}
+
+    Instructions operands;
+    vector<char> operators;
+    vector<size_t> lines;
+    // Unary minuses in front of the opening parenthesis.
+    size_t negations;
+};
+
+InstructionPtr negate(InstructionPtr value, size_t count, size_t line){
+    for (size_t i = 0; i != count; ++i)
+        value = InstructionPtr(new Operator('-', InstructionPtr(new Num(0, 0)), value, line));
+    return value;
+}
+
+// Joins operands[begin, end) into a tree of logarithmic depth. Here
+// operators[i] and lines[i] belong to the operator in front of
+// operands[i], which must be +, - or *. When inverted, + and - are
+// swapped, which is how the operands right of a - are built.
+InstructionPtr balance(Instructions const &operands, vector<char> const &operators, vector<size_t> const &lines,
+                       size_t begin, size_t end, bool inverted){
+    if (end - begin == 1) return operands[begin];
+    size_t middle = begin + (end - begin) / 2;
+    char op = operators[middle];
+    if (inverted && op != '*') op = op == '+' ? '-' : '+';
+    InstructionPtr left = balance(operands, operators, lines, begin, middle, inverted);
+    InstructionPtr right = balance(operands, operators, lines, middle, end, inverted != (op == '-'));
+    return InstructionPtr(new Operator(op, left, right, lines[middle]));
+}
+
+// Builds the operands of level joined by its operators, * and / first.
+InstructionPtr reduce(ExpressionLevel const &level){
+    Instructions const &operands = level.operands;
+    Instructions terms;
+    vector<char> signs;
+    vector<size_t> signLines;
+
+    size_t i = 0;
+    while (i != operands.size()) {
+        InstructionPtr term = operands[i];
+        size_t j = i + 1;
+        while (j != operands.size() && level.operators[j - 1] != '+' && level.operators[j - 1] != '-') {
+            if (level.operators[j - 1] == '/') {
+                term = InstructionPtr(new Operator('/', term, operands[j], level.lines[j - 1]));
+                ++j;
+                continue;
+            }
+            Instructions factors(1, term);
+            vector<char> times(1, '*');
+            vector<size_t> lines(1, 0);
+            for (; j != operands.size() && level.operators[j - 1] == '*'; ++j) {
+                factors.push_back(operands[j]);
+                times.push_back('*');
+                lines.push_back(level.lines[j - 1]);
+            }
+            term = balance(factors, times, lines, 0, factors.size(), false);
+        }
+
+        terms.push_back(term);
+        signs.push_back(i == 0 ? '+' : level.operators[i - 1]);
+        signLines.push_back(i == 0 ? 0 : level.lines[i - 1]);
+        i = j;
+    }
+    // The first term stays at the top, keeping the shape s = s + term
+    // that loop idioms look for.
+    if (terms.size() == 1) return terms[0];
+    InstructionPtr rest = balance(terms, signs, signLines, 1, terms.size(), signs[1] == '-');
+    return InstructionPtr(new Operator(signs[1], terms[0], rest, signLines[1]));
+}
+
+}
 
 ProgramContext Parser::parseProgram(){
     Instructions instructions;
     map<string, FunPtr> functions;
+    InstructionPtr instruction;
+    FunPtr funDef;
+    while (parseTopLevel(instruction, funDef)) {
+        if (instruction) instructions.push_back(instruction);
+        if (funDef) functions[funDef->getName()] = funDef;
+    }
+
+    size_t lineNumber = instructions.empty() ? lexer.getLineNumber() : instructions.at(0)->getLineNumber();
+    return ProgramContext(InstructionPtr(new Program(instructions, lineNumber)), functions);
+}
+
+bool Parser::parseTopLevel(InstructionPtr &instruction, FunPtr &function){
+    instruction.reset();
+    function.reset();
     while (!lexer.checkToken(Token::Eof)) {
-        InstructionPtr instruction = parseInstruction();
-        if (instruction) {
-            instructions.push_back(instruction);
-            continue;
-        }
+        instruction = parseInstruction();
+        if (instruction) return true;
 
-        FunPtr funDef = parseFunDef();
-        if (funDef) {
-            functions[funDef->getName()] = funDef;
-            continue;
-        }
+        function = parseFunDef();
+        if (function) return true;
     }
+    return false;
+}
 
-    return ProgramContext(InstructionPtr(new Program(instructions, instructions.at(0)->getLineNumber())), functions);
+Instructions Parser::parseBody(){
+    Instructions instructions;
+    while (!lexer.checkToken(Token::Eof)) {
+        InstructionPtr instruction = parseInstruction();
+        if (!instruction){
+            //TODO gen error
+            break;
+        }
+        instructions.push_back(instruction);
+    }
+    return instructions;
 }
 
 InstructionPtr Parser::parseInstruction(){
@@ -25,8 +150,9 @@ InstructionPtr Parser::parseInstruction(){
 
     InstructionPtr res = parseRead();
     if (!res) res = parsePrint();
+    if (!res) res = parseIndexAssign();
     if (!res) res = parseVarDef();
-    if (!res) res = parsePlusMinus();
+    if (!res) res = parseExpression();
     if (!res) res = parseIf();
     if (!res) res = parseWhile();
     if (!res) res = parseReturn();
@@ -35,45 +161,56 @@ InstructionPtr Parser::parseInstruction(){
     return res;
 }
 
-InstructionPtr Parser::parsePlusMinus(){
-    InstructionPtr left = parseMultDiv();
-    if (!left) return InstructionPtr();
-
-    if (!lexer.checkToken(Token::PLUS) && !lexer.checkToken(Token::MINUS)) return left;
-    Token op = lexer.nextToken();
-
-    InstructionPtr right = parsePlusMinus();
-    if (!right){
-        //TODO gen error
-    }
-
-    switch (op.type) {
-    case Token::PLUS: return InstructionPtr(new Operator('+', left, right, lexer.getLineNumber()));
-    case Token::MINUS: return InstructionPtr(new Operator('-', left, right, lexer.getLineNumber()));
-    default:{
-        //TODO gen error
-    }
-    }
-}
-
-InstructionPtr Parser::parseMultDiv(){
-    InstructionPtr left = parseValue();
-    if (!left) return InstructionPtr();
-
-    if (!lexer.checkToken(Token::MULT) && !lexer.checkToken(Token::DIV)) return left;
-    Token op = lexer.nextToken();
+// Expressions are parsed without recursion, one ExpressionLevel per open
+// parenthesis, so their length is bounded only by memory. Runs of + and -
+// and of * are built into trees of logarithmic depth that evaluate their
+// operands left to right; all four operators associate to the left.
+InstructionPtr Parser::parseExpression(){
+    vector<ExpressionLevel> levels(1);
+    while (true) {
+        size_t negations = 0;
+        while (lexer.checkToken(Token::MINUS)) {
+            lexer.nextToken();
+            ++negations;
+        }
+        if (lexer.checkToken(Token::LP)) {
+            lexer.nextToken();
+            levels.push_back(ExpressionLevel(negations));
+            continue;
+        }
 
-    InstructionPtr right = parseMultDiv();
-    if (!right){
-        //TODO gen error
-    }
+        InstructionPtr operand = parseNum();
+        if (!operand) operand = parseId();
+        if (!operand){
+            if (levels.size() > 1 || !levels.back().operands.empty() || negations)
+                throw RuntimeError("expected an operand", lexer.getLineNumber());
+            return InstructionPtr();
+        }
+        operand = negate(operand, negations, lexer.getLineNumber());
+
+        while (true) {
+            ExpressionLevel &level = levels.back();
+            level.operands.push_back(operand);
+
+            char op = 0;
+            if (lexer.checkToken(Token::PLUS)) op = '+';
+            else if (lexer.checkToken(Token::MINUS)) op = '-';
+            else if (lexer.checkToken(Token::MULT)) op = '*';
+            else if (lexer.checkToken(Token::DIV)) op = '/';
+            if (op) {
+                lexer.nextToken();
+                level.operators.push_back(op);
+                level.lines.push_back(lexer.getLineNumber());
+                break;
+            }
 
-    switch (op.type) {
-    case Token::MULT: return InstructionPtr(new Operator('*', left, right, lexer.getLineNumber()));
-    case Token::DIV: return InstructionPtr(new Operator('/', left, right, lexer.getLineNumber()));
-    default:{
-        //TODO gen error
-    }
+            bool closed = lexer.checkToken(Token::RP);
+            if (levels.size() == 1) return reduce(level);
+            if (!closed) throw RuntimeError("expected ')'", lexer.getLineNumber());
+            lexer.nextToken();
+            operand = negate(reduce(level), level.negations, lexer.getLineNumber());
+            levels.pop_back();
+        }
     }
 }
 
@@ -81,13 +218,21 @@ InstructionPtr Parser::parseId(){
     if (!lexer.checkToken(Token::ID)) return InstructionPtr();
 
     string id = lexer.nextToken().name;
+    if (lexer.checkToken(Token::LB)) {
+        lexer.nextToken();
+        InstructionPtr index = parseExpression();
+        if (!index) throw RuntimeError("expected an index", lexer.getLineNumber());
+        if (!lexer.checkToken(Token::RB)) throw RuntimeError("expected ']'", lexer.getLineNumber());
+        lexer.nextToken();
+        return InstructionPtr(new Index(id, index, lexer.getLineNumber()));
+    }
     if (!lexer.checkToken(Token::LP)) return InstructionPtr(new Var(id, lexer.getLineNumber()));
     lexer.nextToken();
 
     Instructions functionParams;
     if (!lexer.checkToken(Token::RP)) {
         while(true) {
-            InstructionPtr p = parsePlusMinus();
+            InstructionPtr p = parseExpression();
             if (!p){
                 //TODO gen error
             }
@@ -101,6 +246,10 @@ InstructionPtr Parser::parseId(){
     }
     lexer.nextToken();
 
+    // Built-in array functions take precedence over defs of the same name.
+    ArrayOp::Operation op;
+    if (ArrayOp::lookup(id, op))
+        return InstructionPtr(new ArrayOp(op, functionParams, lexer.getLineNumber()));
     return InstructionPtr(new FunCall(id, functionParams, lexer.getLineNumber()));
 }
 
@@ -120,7 +269,7 @@ InstructionPtr Parser::parseVarDef(){
         //TODO gen error
     }
 
-    InstructionPtr exp = parsePlusMinus();
+    InstructionPtr exp = parseExpression();
     if (!exp){
         //TODO gen error
     }
@@ -128,30 +277,22 @@ InstructionPtr Parser::parseVarDef(){
     return InstructionPtr(new VarDef(id, exp, lexer.getLineNumber()));
 }
 
-InstructionPtr Parser::parseValue(){
-    if (lexer.checkToken(Token::MINUS)) {
-        lexer.nextToken();
-        InstructionPtr val = parseValue();
-        if (!val){
-            //TODO gen error
-        }
-        InstructionPtr zero = InstructionPtr(new Num(0, 0));
-        return InstructionPtr(new Operator('-', zero, val, lexer.getLineNumber()));
-    }
+InstructionPtr Parser::parseIndexAssign(){
+    if (!lexer.checkToken(Token::ID) || !lexer.checkToken(Token::LB, 2)) return InstructionPtr();
+    string id = lexer.nextToken().name;
+    lexer.nextToken();
 
-    if (lexer.checkToken(Token::LP)) {
-        lexer.nextToken();
-        InstructionPtr exp = parsePlusMinus();
-        if (!exp || lexer.nextToken().type != Token::RP){
-            //TODO gen error
-        }
-        return exp;
+    InstructionPtr index = parseExpression();
+    if (!index || lexer.nextToken().type != Token::RB || lexer.nextToken().type != Token::ASGN){
+        //TODO gen error
     }
 
-    InstructionPtr val = parseNum();
-    if (!val) val = parseId();
+    InstructionPtr exp = parseExpression();
+    if (!exp){
+        //TODO gen error
+    }
 
-    return val;
+    return InstructionPtr(new IndexAssign(id, index, exp, lexer.getLineNumber()));
 }
 
 InstructionPtr Parser::parseIf(){
@@ -202,7 +343,7 @@ InstructionPtr Parser::parseReturn(){
     if (!lexer.checkToken(Token::RET)) return InstructionPtr();
     lexer.nextToken();
 
-    InstructionPtr exp = parsePlusMinus();
+    InstructionPtr exp = parseExpression();
     if (!exp){
         //TODO gen error
     }
@@ -210,7 +351,7 @@ InstructionPtr Parser::parseReturn(){
 }
 
 InstructionPtr Parser::parseCond(){
-    InstructionPtr left = parsePlusMinus();
+    InstructionPtr left = parseExpression();
     if (!left) return InstructionPtr();
 
     Token ct = lexer.nextToken();
@@ -218,7 +359,7 @@ InstructionPtr Parser::parseCond(){
         //TODO gen error
     }
 
-    InstructionPtr right = parsePlusMinus();
+    InstructionPtr right = parseExpression();
     if (!right){
         //TODO gen error
     }
@@ -253,7 +394,7 @@ InstructionPtr Parser::parsePrint(){
     if (!lexer.checkToken(Token::PRINT)) return InstructionPtr();
     lexer.nextToken();
 
-    InstructionPtr exp = parsePlusMinus();
+    InstructionPtr exp = parseExpression();
     if (!exp){
         //TODO gen error
     }
@@ -266,6 +407,7 @@ FunPtr Parser::parseFunDef(){
     lexer.nextToken();
 
     Token functionName = lexer.nextToken();
+    size_t line = lexer.getLineNumber();
     if (functionName.type != Token::ID || lexer.nextToken().type != Token::LP){
         //TODO gen error
     }
@@ -291,8 +433,19 @@ FunPtr Parser::parseFunDef(){
         //TODO gen error
     }
 
+    if (lazySource) {
+        LazyBodyPtr body = skipFunBody();
+        if (!body) throw RuntimeError("def without end", line);
+        lexer.nextToken();
+        if (lexer.nextToken().type != Token::CR){
+            //TODO gen error
+        }
+        return FunPtr(new FunDef(functionName.name, functionParams, body, lexer.getLineNumber()));
+    }
+
     Instructions instructions;
     while (!lexer.checkToken(Token::END)) {
+        if (lexer.checkToken(Token::Eof)) throw RuntimeError("def without end", line);
         InstructionPtr instruction = parseInstruction();
         instructions.push_back(instruction);
         continue;
@@ -305,3 +458,22 @@ FunPtr Parser::parseFunDef(){
 
     return FunPtr(new FunDef(functionName.name, functionParams, instructions, lexer.getLineNumber()));
 }
+
+// Moves past the tokens of a def body, stopping in front of its closing
+// end, and returns the skipped byte range for parsing later; null if the
+// source ends first.
+LazyBodyPtr Parser::skipFunBody(){
+    size_t begin = lexer.getOffset();
+    size_t firstLine = lexer.getLineNumber();
+
+    int depth = 0;
+    while (true) {
+        size_t position = lexer.getOffset();
+        if (lexer.checkToken(Token::Eof)) return LazyBodyPtr();
+        if (lexer.checkToken(Token::END) && depth == 0)
+            return LazyBodyPtr(new SourceRange(lazySource, begin, position, firstLine));
+        Token token = lexer.nextToken();
+        if (token.type == Token::IF || token.type == Token::WHILE) ++depth;
+        if (token.type == Token::END) --depth;
+    }
+}
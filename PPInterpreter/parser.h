@@ -2,37 +2,58 @@
 #define PARSER_H
 
 #include <tr1/memory>
+#include <string>
 #include <vector>
 #include "ast.h"
 #include "lexer.h"
 #include "programContext.h"
 
+using std::string;
 using std::tr1::shared_ptr;
 
 struct Parser
 {
-    Parser(istream &sourceStream):
-        lexer(sourceStream)
+    Parser(istream &sourceStream, size_t firstLine = 1):
+        lexer(sourceStream, firstLine)
     {}
 
+    // Enables lazy defs: only the signature is parsed up front, and the
+    // body is parsed from this copy of the source on its first call.
+    // The source must be the exact text the stream reads.
+    void setLazySource(shared_ptr<string const> const &source){
+        lazySource = source;
+    }
+
+    // Lexes the whole source now instead of as parsing goes.
+    void lexAll(){
+        lexer.lexAll();
+    }
+
     ProgramContext parse(){
         return parseProgram();
     }
 
+    // Parses the next top-level statement or def into one of the two
+    // pointers. Returns false at the end of the source.
+    bool parseTopLevel(InstructionPtr &instruction, FunPtr &function);
+
+    // Parses statements up to the end of the source.
+    Instructions parseBody();
+
     size_t getLine() const{
         return lexer.getLineNumber();
     }
 private:
     Lexer lexer;
+    shared_ptr<string const> lazySource;
 
     ProgramContext parseProgram();
     InstructionPtr parseInstruction();
-    InstructionPtr parsePlusMinus();
-    InstructionPtr parseMultDiv();
+    InstructionPtr parseExpression();
     InstructionPtr parseId();
     InstructionPtr parseNum();
     InstructionPtr parseVarDef();
-    InstructionPtr parseValue();
+    InstructionPtr parseIndexAssign();
     InstructionPtr parseIf();
     InstructionPtr parseWhile();
     InstructionPtr parseReturn();
@@ -40,6 +61,7 @@ private:
     InstructionPtr parseRead();
     InstructionPtr parsePrint();
     FunPtr parseFunDef();
+    LazyBodyPtr skipFunBody();
 };
 
 #endif // PARSER_H
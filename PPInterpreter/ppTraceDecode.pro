@@ -0,0 +1,10 @@
+# Offline decoder for files written by "PPInterpreter --trace".
+TEMPLATE = app
+TARGET = pptracedecode
+CONFIG += console
+CONFIG -= qt
+CONFIG += c++11
+
+SOURCES += traceDecode.cpp
+
+HEADERS += trace.h
@@ -0,0 +1,22 @@
+#ifndef RUNTIMEERROR_H
+#define RUNTIMEERROR_H
+
+#include <stdexcept>
+#include <string>
+
+// Error of a PP program, raised by parsing or running it.
+struct RuntimeError: public std::runtime_error {
+    RuntimeError(std::string const &message, size_t lineNumber):
+        std::runtime_error(message),
+        lineNumber(lineNumber)
+    {}
+
+    size_t getLineNumber() const{
+        return lineNumber;
+    }
+
+private:
+    size_t lineNumber;
+};
+
+#endif // RUNTIMEERROR_H
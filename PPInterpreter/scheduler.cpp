@@ -0,0 +1,279 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <new>
+#include "scheduler.h"
+
+Task::Task(Scheduler &scheduler, CompiledProgram const &program, size_t stackSize):
+    scheduler(scheduler),
+    program(program),
+    context(*program, *this),
+    workerContext(0),
+    stack(0),
+    stackSize(stackSize),
+    state(RUNNABLE),
+    parkRequested(false),
+    returned(false),
+    inputClosed(false),
+    cancelled(false)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    void *memory = mmap(0, stackSize + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) throw std::bad_alloc();
+    // Guard page so that an overflow faults instead of corrupting the heap.
+    mprotect(memory, page, PROT_NONE);
+    stack = static_cast<char *>(memory);
+
+    // Deep recursion fails with a RuntimeError an eighth of the stack
+    // short of the guard page.
+    context.setStackLimit(stack + page + stackSize / 8);
+
+    getcontext(&taskContext);
+    taskContext.uc_stack.ss_sp = stack + page;
+    taskContext.uc_stack.ss_size = stackSize;
+    taskContext.uc_link = 0;
+    uintptr_t address = reinterpret_cast<uintptr_t>(this);
+    makecontext(&taskContext, reinterpret_cast<void (*)()>(&Task::entry), 2,
+                static_cast<unsigned>(address), static_cast<unsigned>(static_cast<uint64_t>(address) >> 32));
+}
+
+Task::~Task(){
+    munmap(stack, stackSize + sysconf(_SC_PAGESIZE));
+}
+
+void Task::entry(unsigned low, unsigned high){
+    Task *task = reinterpret_cast<Task *>(static_cast<uintptr_t>((static_cast<uint64_t>(high) << 32) | low));
+    task->context.setPreemption(task, task->scheduler.instructionBudget);
+    try {
+        task->context.run();
+    } catch (std::exception const &e) {
+        // Nothing may unwind past the bottom of a task stack.
+        task->error = e.what();
+    }
+    task->returned = true;
+    task->switchToWorker();
+}
+
+void Task::resume(ucontext_t *worker){
+    workerContext = worker;
+    swapcontext(worker, &taskContext);
+}
+
+void Task::switchToWorker(){
+    swapcontext(&taskContext, workerContext);
+}
+
+void Task::yield(){
+    checkCancelled();
+    switchToWorker();
+    checkCancelled();
+}
+
+// Unwinds the task stack of a task its scheduler gave up on.
+void Task::checkCancelled(){
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cancelled) throw RuntimeError("cancelled", 0);
+}
+
+bool Task::read(int &value){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (input.empty()) {
+        if (cancelled) throw RuntimeError("cancelled", 0);
+        if (inputClosed) return false;
+        // The worker decides whether to park once this stack is switched
+        // out, so a concurrent pushInput() cannot resume it too early.
+        parkRequested = true;
+        lock.unlock();
+        switchToWorker();
+        lock.lock();
+    }
+    value = input.front();
+    input.pop_front();
+    return true;
+}
+
+void Task::print(int value){
+    output.push_back(value);
+}
+
+void Task::pushInput(int value){
+    std::unique_lock<std::mutex> lock(mutex);
+    input.push_back(value);
+    unpark(lock);
+}
+
+void Task::closeInput(){
+    std::unique_lock<std::mutex> lock(mutex);
+    inputClosed = true;
+    unpark(lock);
+}
+
+void Task::cancel(){
+    std::unique_lock<std::mutex> lock(mutex);
+    cancelled = true;
+    unpark(lock);
+}
+
+void Task::unpark(std::unique_lock<std::mutex> &lock){
+    if (state != PARKED) return;
+    state = RUNNABLE;
+    lock.unlock();
+    scheduler.enqueue(shared_from_this(), scheduler.workers.size());
+}
+
+bool Task::isFinished() const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return state == FINISHED;
+}
+
+Scheduler::Scheduler(size_t workerCount, unsigned instructionBudget, size_t stackSize):
+    instructionBudget(instructionBudget),
+    stackSize(stackSize),
+    queued(0),
+    idle(0),
+    nextWorker(0),
+    unfinished(0),
+    stopping(false)
+{
+    if (workerCount == 0) workerCount = std::thread::hardware_concurrency();
+    if (workerCount == 0) workerCount = 1;
+    for (size_t i = 0; i != workerCount; ++i)
+        workers.push_back(new Worker());
+    for (size_t i = 0; i != workerCount; ++i)
+        workers[i]->thread = std::thread(&Scheduler::run, this, i);
+}
+
+Scheduler::~Scheduler(){
+    // Parked and queued tasks hold their own references and point back
+    // here, so they are cancelled and run to the end before the workers
+    // stop.
+    vector<TaskPtr> unfinishedTasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (set<Task *>::iterator it = tasks.begin(); it != tasks.end(); ++it) {
+            std::lock_guard<std::mutex> taskLock((*it)->mutex);
+            if ((*it)->self) unfinishedTasks.push_back((*it)->self);
+        }
+    }
+    for (size_t i = 0; i != unfinishedTasks.size(); ++i)
+        unfinishedTasks[i]->cancel();
+    unfinishedTasks.clear();
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    // A worker may still be stealing from another's queue until it stops.
+    for (size_t i = 0; i != workers.size(); ++i)
+        workers[i]->thread.join();
+    for (size_t i = 0; i != workers.size(); ++i)
+        delete workers[i];
+}
+
+TaskPtr Scheduler::spawn(CompiledProgram const &program){
+    TaskPtr task(new Task(*this, program, stackSize));
+    task->self = task;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++unfinished;
+        tasks.insert(task.get());
+    }
+    enqueue(task, workers.size());
+    return task;
+}
+
+void Scheduler::wait(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (unfinished != 0) allFinished.wait(lock);
+}
+
+// worker == workers.size() means the caller is not a worker: pick one round robin.
+void Scheduler::enqueue(TaskPtr const &task, size_t worker){
+    if (worker == workers.size()) worker = nextWorker++ % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[worker]->mutex);
+        workers[worker]->queue.push_back(task);
+    }
+    // A waiting worker counts itself idle before it checks queued, so
+    // either it sees this task or this sees it idle. It holds the mutex
+    // until it waits, so the notify cannot come too early.
+    ++queued;
+    if (idle == 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    workAvailable.notify_one();
+}
+
+bool Scheduler::take(size_t worker, TaskPtr &task){
+    bool found = false;
+    {
+        Worker &own = *workers[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.queue.empty()) {
+            task = own.queue.back();
+            own.queue.pop_back();
+            found = true;
+        }
+    }
+    for (size_t i = 1; !found && i != workers.size(); ++i) {
+        Worker &victim = *workers[(worker + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.queue.empty()) {
+            task = victim.queue.front();
+            victim.queue.pop_front();
+            found = true;
+        }
+    }
+    if (found) --queued;
+    return found;
+}
+
+void Scheduler::run(size_t worker){
+    ucontext_t workerContext;
+    while (true) {
+        TaskPtr task;
+        if (!take(worker, task)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping) return;
+            ++idle;
+            if (queued <= 0) workAvailable.wait(lock);
+            --idle;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(task->mutex);
+            task->state = Task::RUNNING;
+        }
+        task->resume(&workerContext);
+        suspended(task, worker);
+    }
+}
+
+void Scheduler::suspended(TaskPtr const &task, size_t worker){
+    std::unique_lock<std::mutex> lock(task->mutex);
+    if (task->returned) {
+        task->state = Task::FINISHED;
+        task->self.reset();
+        lock.unlock();
+        finished(*task);
+        return;
+    }
+    if (task->parkRequested) {
+        task->parkRequested = false;
+        if (task->input.empty() && !task->inputClosed && !task->cancelled) {
+            task->state = Task::PARKED;
+            return;
+        }
+    }
+    task->state = Task::RUNNABLE;
+    lock.unlock();
+    enqueue(task, worker);
+}
+
+void Scheduler::finished(Task &task){
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.erase(&task);
+    if (--unfinished == 0) allFinished.notify_all();
+}
@@ -0,0 +1,148 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <ucontext.h>
+#include <atomic>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <tr1/memory>
+#include "engine.h"
+#include "interpreter.h"
+
+using std::deque;
+using std::set;
+using std::string;
+using std::vector;
+using std::tr1::shared_ptr;
+
+class Scheduler;
+
+// One PP program running as a green thread. It has its own native stack
+// and ExecutionContext. A worker runs it until it uses up its instruction
+// budget or reads with no input pending. Then it goes back to the run
+// queue or is parked until pushInput() or closeInput().
+class Task: public InputOutput, public Preemption, public std::tr1::enable_shared_from_this<Task> {
+public:
+    enum State{
+        RUNNABLE, RUNNING, PARKED, FINISHED
+    };
+
+    ~Task();
+
+    void pushInput(int value);
+    // Further reads fail with a RuntimeError instead of parking.
+    void closeInput();
+    // The next read or preemption throws, so the task ends with the
+    // error "cancelled".
+    void cancel();
+
+    bool isFinished() const;
+    // Valid once the task is finished.
+    vector<int> const &getOutput() const{
+        return output;
+    }
+    string const &getError() const{
+        return error;
+    }
+
+    bool read(int &value);
+    void print(int value);
+    void yield();
+
+private:
+    friend class Scheduler;
+
+    Task(Scheduler &scheduler, CompiledProgram const &program, size_t stackSize);
+
+    static void entry(unsigned low, unsigned high);
+    void resume(ucontext_t *worker);
+    void switchToWorker();
+    void checkCancelled();
+    void unpark(std::unique_lock<std::mutex> &lock);
+
+    Scheduler &scheduler;
+    // Keeps a parked task alive until it finishes.
+    shared_ptr<Task> self;
+    CompiledProgram program;
+    ExecutionContext context;
+
+    ucontext_t taskContext;
+    ucontext_t *workerContext;
+    char *stack;
+    size_t stackSize;
+
+    mutable std::mutex mutex;
+    State state;
+    bool parkRequested;
+    bool returned;
+    deque<int> input;
+    bool inputClosed;
+    bool cancelled;
+
+    vector<int> output;
+    string error;
+
+    Task(Task const &);
+    Task &operator=(Task const &);
+};
+
+typedef shared_ptr<Task> TaskPtr;
+
+// Fixed pool of worker threads running Tasks. Each worker owns a run
+// queue and steals from the others when its own queue is empty.
+// Destroying it cancels the tasks that have not finished and waits for
+// them.
+class Scheduler {
+public:
+    // workerCount 0 means one worker per hardware thread.
+    explicit Scheduler(size_t workerCount = 0, unsigned instructionBudget = 10000, size_t stackSize = 1 << 20);
+    ~Scheduler();
+
+    TaskPtr spawn(CompiledProgram const &program);
+
+    // Blocks until every spawned task has finished.
+    void wait();
+
+private:
+    friend class Task;
+
+    struct Worker {
+        std::mutex mutex;
+        deque<TaskPtr> queue;
+        std::thread thread;
+    };
+
+    unsigned instructionBudget;
+    size_t stackSize;
+    vector<Worker *> workers;
+
+    // Tasks in the run queues, and workers waiting for one. Kept outside
+    // the mutex, which enqueue() only takes to wake a waiting worker.
+    std::atomic<long> queued;
+    std::atomic<size_t> idle;
+    std::atomic<size_t> nextWorker;
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allFinished;
+    // Unfinished tasks, for cancelling them on destruction.
+    set<Task *> tasks;
+    size_t unfinished;
+    bool stopping;
+
+    void enqueue(TaskPtr const &task, size_t worker);
+    bool take(size_t worker, TaskPtr &task);
+    void run(size_t worker);
+    void suspended(TaskPtr const &task, size_t worker);
+    void finished(Task &task);
+
+    Scheduler(Scheduler const &);
+    Scheduler &operator=(Scheduler const &);
+};
+
+#endif // SCHEDULER_H
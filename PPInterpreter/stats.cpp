@@ -0,0 +1,212 @@
+#include <chrono>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "stats.h"
+#include "staticVisitor.h"
+
+static long long now(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+// Counts this thread and the threads it starts afterwards, such as the
+// tiering compiler, each added to the total when it exits. A thread still
+// running at the end of a phase is not included in that phase.
+static int openCounter(unsigned type, unsigned long long config){
+    perf_event_attr attr = perf_event_attr();
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+Stats::Stats():
+    startNanoseconds(0),
+    startBytes(0),
+    startAllocations(0)
+{
+    countAllocations();
+    for (int i = 0; i != COUNTERS; ++i) counters[i] = -1;
+#ifdef __linux__
+    counters[CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters[INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters[CACHE_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters[BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+}
+
+Stats::~Stats(){
+#ifdef __linux__
+    for (int i = 0; i != COUNTERS; ++i)
+        if (counters[i] != -1) close(counters[i]);
+#endif
+}
+
+void Stats::beginPhase(string const &name){
+    phases.push_back(PhaseStats(name));
+#ifdef __linux__
+    for (int i = 0; i != COUNTERS; ++i) {
+        if (counters[i] == -1) continue;
+        ioctl(counters[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    startBytes = allocatedBytes();
+    startAllocations = allocationCount();
+    startNanoseconds = now();
+}
+
+void Stats::endPhase(){
+    long long endNanoseconds = now();
+    PhaseStats &phase = phases.back();
+    phase.wallNanoseconds = endNanoseconds - startNanoseconds;
+    phase.allocatedBytes = allocatedBytes() - startBytes;
+    phase.allocations = allocationCount() - startAllocations;
+#ifdef __linux__
+    long long *values[COUNTERS] = {&phase.cycles, &phase.instructions, &phase.cacheMisses, &phase.branchMisses};
+    for (int i = 0; i != COUNTERS; ++i) {
+        if (counters[i] == -1) continue;
+        ioctl(counters[i], PERF_EVENT_IOC_DISABLE, 0);
+        long long value = 0;
+        if (read(counters[i], &value, sizeof(value)) == sizeof(value))
+            *values[i] = value;
+    }
+#endif
+}
+
+namespace {
+
+class NodeCounter: public StaticVisitor<NodeCounter> {
+public:
+    NodeCounter(map<string, long long> &counts): counts(counts) {}
+
+    int visit(Program const &node){ return list("Program", node); }
+    int visit(FunDef const &node){ return list("FunDef", node); }
+    int visit(VarDef const &node){ return unary("VarDef", node.getExp()); }
+    int visit(Num const &){ return leaf("Num"); }
+    int visit(Var const &){ return leaf("Var"); }
+    int visit(FunCall const &node){
+        ++counts["FunCall"];
+        count(node.getParams());
+        return 0;
+    }
+    int visit(Operator const &node){ return binary("Operator", node.getLeft(), node.getRight()); }
+    int visit(Cond const &node){ return binary("Cond", node.getLeft(), node.getRight()); }
+    int visit(If const &node){
+        dispatch(node.getCond());
+        return list("If", node);
+    }
+    int visit(While const &node){
+        dispatch(node.getCond());
+        return list("While", node);
+    }
+    int visit(Return const &node){ return unary("Return", node.getExp()); }
+    int visit(Read const &){ return leaf("Read"); }
+    int visit(Print const &node){ return unary("Print", node.getExp()); }
+    int visit(Index const &node){ return unary("Index", node.getIndex()); }
+    int visit(IndexAssign const &node){ return binary("IndexAssign", node.getIndex(), node.getExp()); }
+    int visit(ArrayOp const &node){
+        ++counts["ArrayOp"];
+        count(node.getParams());
+        return 0;
+    }
+    int visit(InlinedCall const &node){
+        ++counts["InlinedCall"];
+        count(node.getArgs());
+        if (node.getBody()) dispatch(node.getBody());
+        return 0;
+    }
+
+private:
+    map<string, long long> &counts;
+
+    void count(Instructions const &instructions){
+        for (size_t i = 0; i != instructions.size(); ++i)
+            if (instructions[i]) dispatch(instructions[i]);
+    }
+
+    int leaf(char const *name){
+        ++counts[name];
+        return 0;
+    }
+
+    int unary(char const *name, InstructionPtr const &child){
+        ++counts[name];
+        if (child) dispatch(child);
+        return 0;
+    }
+
+    int binary(char const *name, InstructionPtr const &left, InstructionPtr const &right){
+        ++counts[name];
+        if (left) dispatch(left);
+        if (right) dispatch(right);
+        return 0;
+    }
+
+    int list(char const *name, InstructionList const &node){
+        ++counts[name];
+        count(node.getInstructions());
+        return 0;
+    }
+};
+
+}
+
+void Stats::countNodes(ProgramContext const &program){
+    NodeCounter counter(nodeCounts);
+    counter.dispatch(program.entryPoint);
+    for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it)
+        counter.dispatch(*it->second);
+}
+
+static void writeField(ostream &out, char const *name, long long value){
+    if (value >= 0) out << ", \"" << name << "\": " << value;
+}
+
+void Stats::write(ostream &out) const{
+    bool hardware = false;
+    for (int i = 0; i != COUNTERS; ++i)
+        if (counters[i] != -1) hardware = true;
+
+    out << "{\"counters\": \"" << (hardware ? "perf_event" : "timer") << "\", \"phases\": [";
+    for (size_t i = 0; i != phases.size(); ++i) {
+        PhaseStats const &phase = phases[i];
+        out << (i ? ", " : "") << "{\"name\": \"" << phase.name << "\"";
+        writeField(out, "wall_ns", phase.wallNanoseconds);
+        writeField(out, "cycles", phase.cycles);
+        writeField(out, "instructions", phase.instructions);
+        writeField(out, "cache_misses", phase.cacheMisses);
+        writeField(out, "branch_misses", phase.branchMisses);
+        writeField(out, "allocated_bytes", phase.allocatedBytes);
+        writeField(out, "allocations", phase.allocations);
+        out << "}";
+    }
+
+    out << "], \"ast_nodes\": {";
+    long long total = 0;
+    for (map<string, long long>::const_iterator it = nodeCounts.begin(); it != nodeCounts.end(); ++it) {
+        out << '"' << it->first << "\": " << it->second << ", ";
+        total += it->second;
+    }
+    out << "\"total\": " << total << "}";
+
+#ifndef _WIN32
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        out << ", \"peak_rss_kb\": " << usage.ru_maxrss;
+#endif
+    out << "}" << std::endl;
+}
@@ -0,0 +1,76 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "engine.h"
+#include "programContext.h"
+
+using std::map;
+using std::string;
+using std::vector;
+using std::ostream;
+
+// Cost of one interpreter phase. Hardware counters come from
+// perf_event_open where the kernel allows it; wall time and heap
+// allocations are always recorded.
+struct PhaseStats {
+    string name;
+    long long wallNanoseconds;
+    // Missing counters stay at -1 and are left out of the report.
+    long long cycles;
+    long long instructions;
+    long long cacheMisses;
+    long long branchMisses;
+    long long allocatedBytes;
+    long long allocations;
+
+    PhaseStats(string const &name):
+        name(name),
+        wallNanoseconds(0),
+        cycles(-1),
+        instructions(-1),
+        cacheMisses(-1),
+        branchMisses(-1),
+        allocatedBytes(0),
+        allocations(0)
+    {}
+};
+
+// Collects --stats data for one run and writes it as a JSON object.
+class Stats: public CompilePhases {
+public:
+    Stats();
+    ~Stats();
+
+    void beginPhase(string const &name);
+    void endPhase();
+
+    void countNodes(ProgramContext const &program);
+
+    void write(ostream &out) const;
+
+private:
+    enum { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTERS };
+
+    int counters[COUNTERS];
+    vector<PhaseStats> phases;
+    map<string, long long> nodeCounts;
+
+    long long startNanoseconds;
+    long long startBytes;
+    long long startAllocations;
+
+    Stats(Stats const &);
+    Stats &operator=(Stats const &);
+};
+
+// Totals maintained by the global operator new of the interpreter binary.
+// Nothing is counted until countAllocations(), which Stats calls.
+void countAllocations();
+long long allocatedBytes();
+long long allocationCount();
+
+#endif // STATS_H
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <sstream>
+#include "tiering.h"
+
+using std::ostringstream;
+
+TierManager::TierManager(unsigned functionThreshold, unsigned loopThreshold, ostream *debug):
+    functionThreshold(functionThreshold ? functionThreshold : 1),
+    loopThreshold(loopThreshold ? loopThreshold : 1),
+    debug(debug),
+    stopping(false)
+{
+    if (debug)
+        *debug << "tier: function threshold " << this->functionThreshold << " calls, loop threshold "
+               << this->loopThreshold << " back-edges" << std::endl;
+    compiler = std::thread(&TierManager::run, this);
+}
+
+TierManager::~TierManager(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_one();
+    compiler.join();
+    // Bodies still waiting would otherwise stay QUEUED for good, and no
+    // other manager could pick them up.
+    for (size_t i = 0; i != jobs.size(); ++i)
+        jobs[i].tier->state.store(TierSlot::COLD);
+    jobs.clear();
+}
+
+void TierManager::onStackReplacement(While const &loop){
+    if (!debug) return;
+    Job job = {0, 0, &loop, 0};
+    log(job, "on-stack replacement into", "");
+}
+
+void TierManager::request(TierSlot &tier, FunDef const *function, While const *loop, ProgramContext const &program){
+    int expected = TierSlot::COLD;
+    if (!tier.state.compare_exchange_strong(expected, TierSlot::QUEUED)) return;
+
+    Job job = {&tier, function, loop, &program};
+    if (debug) {
+        ostringstream detail;
+        detail << "after " << tier.hotness.load(std::memory_order_relaxed) << (function ? " calls" : " back-edges");
+        log(job, "queued", detail.str().c_str());
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    jobAvailable.notify_one();
+}
+
+void TierManager::run(){
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (jobs.empty() && !stopping) jobAvailable.wait(lock);
+            if (stopping) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        BytecodePtr code = job.function ? compileFunction(*job.function, *job.program) : compileLoop(*job.loop, *job.program);
+        long long micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        if (!code) {
+            job.tier->state.store(TierSlot::FAILED);
+            if (debug) log(job, "kept in the AST tier:", "unsupported construct");
+            continue;
+        }
+        job.tier->owner = code;
+        job.tier->code.store(code.get(), std::memory_order_release);
+        job.tier->state.store(TierSlot::COMPILED);
+        if (debug) {
+            ostringstream detail;
+            detail << "in " << micros << " us, " << code->code.size() << " instructions, " << code->slots.size() << " slots";
+            log(job, "compiled", detail.str().c_str());
+        }
+    }
+}
+
+void TierManager::log(Job const &job, char const *event, char const *detail){
+    ostringstream line;
+    line << "tier: " << event << ' ';
+    if (job.function)
+        line << "def " << job.function->getName() << " (line " << job.function->getLineNumber() << ")";
+    else
+        line << "while at line " << job.loop->getLineNumber();
+    if (*detail) line << ' ' << detail;
+    line << '\n';
+
+    std::lock_guard<std::mutex> lock(mutex);
+    *debug << line.str() << std::flush;
+}
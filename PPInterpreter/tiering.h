@@ -0,0 +1,80 @@
+#ifndef TIERING_H
+#define TIERING_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <iostream>
+#include "ast.h"
+#include "bytecode.h"
+#include "programContext.h"
+
+using std::deque;
+using std::ostream;
+
+// Moves hot code from the AST tier to Bytecode. ExecutionContext reports
+// def entries and while back-edges. When a body crosses its threshold, it
+// is queued for a background thread, and later runs use the compiled code.
+// One manager can serve many contexts and programs. Each program must
+// outlive the manager: destroying it returns bodies still queued to the
+// AST tier, so that a later manager can compile them.
+class TierManager {
+public:
+    TierManager(unsigned functionThreshold = 1000, unsigned loopThreshold = 1000, ostream *debug = 0);
+    ~TierManager();
+
+    // Each returns the optimized code once it is ready, null until then.
+    Bytecode const *enter(FunDef const &function, ProgramContext const &program){
+        return count(function.getTier(), functionThreshold, &function, 0, program);
+    }
+
+    Bytecode const *backEdge(While const &loop, ProgramContext const &program){
+        return count(loop.getTier(), loopThreshold, 0, &loop, program);
+    }
+
+    Bytecode const *loopCode(While const &loop) const{
+        return loop.getTier().code.load(std::memory_order_acquire);
+    }
+
+    void onStackReplacement(While const &loop);
+
+private:
+    struct Job {
+        TierSlot *tier;
+        FunDef const *function;
+        While const *loop;
+        ProgramContext const *program;
+    };
+
+    unsigned functionThreshold;
+    unsigned loopThreshold;
+    ostream *debug;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    deque<Job> jobs;
+    bool stopping;
+    std::thread compiler;
+
+    Bytecode const *count(TierSlot &tier, unsigned threshold, FunDef const *function, While const *loop, ProgramContext const &program){
+        Bytecode const *code = tier.code.load(std::memory_order_acquire);
+        if (code) return code;
+        // A plain load and store instead of fetch_add: a lost update only
+        // delays tier-up, and threads do not serialize on the counter.
+        unsigned hotness = tier.hotness.load(std::memory_order_relaxed) + 1;
+        tier.hotness.store(hotness, std::memory_order_relaxed);
+        if (hotness >= threshold && tier.state.load(std::memory_order_relaxed) == TierSlot::COLD)
+            request(tier, function, loop, program);
+        return 0;
+    }
+
+    void request(TierSlot &tier, FunDef const *function, While const *loop, ProgramContext const &program);
+    void run();
+    void log(Job const &job, char const *event, char const *detail);
+
+    TierManager(TierManager const &);
+    TierManager &operator=(TierManager const &);
+};
+
+#endif // TIERING_H
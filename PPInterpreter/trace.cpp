@@ -0,0 +1,118 @@
+#include <cstring>
+#include "trace.h"
+#include "ast.h"
+
+TraceBuffer::TraceBuffer(TraceRecorder &recorder, unsigned id, std::chrono::steady_clock::time_point start, unsigned capacity):
+    recorder(recorder),
+    id(id),
+    start(start),
+    capacity(capacity),
+    events(capacity),
+    head(0),
+    tail(0),
+    lost(0),
+    skipped(0),
+    lostReturns(0),
+    lostTime(0)
+{}
+
+int TraceBuffer::nameOf(FunDef const &function){
+    map<FunDef const *, int>::const_iterator it = names.find(&function);
+    if (it != names.end()) return it->second;
+    return names[&function] = recorder.intern(function.getName());
+}
+
+TraceRecorder::TraceRecorder(string const &path, unsigned flushMillis, unsigned bufferEvents):
+    out(path.c_str(), std::ios::binary),
+    flushMillis(flushMillis),
+    bufferEvents(bufferEvents),
+    start(std::chrono::steady_clock::now()),
+    namesWritten(0),
+    stopping(false)
+{
+    TraceHeader header;
+    memcpy(header.magic, traceMagic, sizeof(header.magic));
+    header.version = traceVersion;
+    header.eventSize = sizeof(TraceEvent);
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    flusher = std::thread(&TraceRecorder::run, this);
+}
+
+TraceRecorder::~TraceRecorder(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    flusher.join();
+    flush(true);
+}
+
+TraceBuffer *TraceRecorder::attach(){
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.push_back(shared_ptr<TraceBuffer>(new TraceBuffer(*this, buffers.size(), start, bufferEvents)));
+    return buffers.back().get();
+}
+
+int TraceRecorder::intern(string const &name){
+    std::lock_guard<std::mutex> lock(mutex);
+    map<string, int>::const_iterator it = nameIds.find(name);
+    if (it != nameIds.end()) return it->second;
+    names.push_back(name);
+    return nameIds[name] = names.size() - 1;
+}
+
+void TraceRecorder::run(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(flushMillis));
+        lock.unlock();
+        flush(false);
+        lock.lock();
+    }
+}
+
+// Only the flusher thread calls this, or the destructor once it stopped
+// with final set.
+void TraceRecorder::flush(bool final){
+    vector<shared_ptr<TraceBuffer> > pending;
+    vector<string> newNames;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = buffers;
+        newNames.assign(names.begin() + namesWritten, names.end());
+        namesWritten = names.size();
+    }
+
+    for (size_t i = 0; i != newNames.size(); ++i)
+        writeChunk(TraceChunk::NAME, namesWritten - newNames.size() + i, newNames[i].size(), newNames[i].data(), newNames[i].size());
+
+    for (size_t i = 0; i != pending.size(); ++i) {
+        TraceBuffer &buffer = *pending[i];
+        unsigned head = buffer.head.load(std::memory_order_acquire);
+        unsigned tail = buffer.tail.load(std::memory_order_relaxed);
+        while (tail != head) {
+            // The unread events may wrap around the end of the ring.
+            unsigned offset = tail & (buffer.capacity - 1);
+            unsigned count = head - tail;
+            if (count > buffer.capacity - offset) count = buffer.capacity - offset;
+            writeChunk(TraceChunk::EVENTS, buffer.id, count, &buffer.events[offset], count * sizeof(TraceEvent));
+            tail += count;
+        }
+        buffer.tail.store(tail, std::memory_order_release);
+
+        // A gap the program did not live to record; the decoder ends the
+        // calls it leaves open.
+        if (final && buffer.lost) writeChunk(TraceChunk::DROPPED, buffer.id, buffer.lost, 0, 0);
+    }
+    out.flush();
+}
+
+void TraceRecorder::writeChunk(TraceChunk::Type type, unsigned buffer, unsigned size, void const *data, size_t bytes){
+    TraceChunk chunk;
+    chunk.type = type;
+    chunk.buffer = buffer;
+    chunk.size = size;
+    out.write(reinterpret_cast<char const *>(&chunk), sizeof(chunk));
+    if (bytes) out.write(static_cast<char const *>(data), bytes);
+}
@@ -0,0 +1,200 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <tr1/memory>
+
+using std::map;
+using std::string;
+using std::vector;
+using std::tr1::shared_ptr;
+
+struct FunDef;
+
+// On-disk format, in host byte order: a TraceHeader, then TraceChunks
+// each followed by its payload. pptracedecode turns it into text or
+// Chrome trace JSON.
+struct TraceHeader {
+    char magic[8];
+    unsigned version;
+    unsigned eventSize;
+};
+
+static char const traceMagic[8] = {'P', 'P', 'T', 'R', 'A', 'C', 'E', '\0'};
+// Version 2 added TraceEvent::UNWIND and version 3 TraceEvent::DROPPED;
+// decoders still read version 1.
+static unsigned const traceVersion = 3;
+
+struct TraceChunk {
+    enum Type{
+        // size events of buffer follow.
+        EVENTS,
+        // Function name number buffer follows, size bytes long.
+        NAME,
+        // buffer lost size events because its ring was full. Since version
+        // 3 only written at the end of a trace that ends in a gap.
+        DROPPED
+    };
+
+    unsigned type;
+    unsigned buffer;
+    unsigned size;
+};
+
+struct TraceEvent {
+    enum Kind{
+        // value is the number of the function name.
+        CALL,
+        // value is the returned value.
+        RETURN,
+        // value is the evaluated condition, one event per evaluation.
+        IF, WHILE,
+        READ, PRINT,
+        // A call left by an error instead of a return; value is unused.
+        UNWIND,
+        // value events were lost while the ring was full, ending line of
+        // the calls recorded before them. The time is that of the first.
+        DROPPED
+    };
+
+    // Kind in the low 8 bits, nanoseconds since the recording started
+    // above them.
+    unsigned long long stamp;
+    unsigned line;
+    int value;
+
+    Kind getKind() const{
+        return static_cast<Kind>(stamp & 0xFF);
+    }
+
+    unsigned long long getTime() const{
+        return stamp >> 8;
+    }
+};
+
+class TraceRecorder;
+
+// Ring of events written by one ExecutionContext and drained by the
+// recorder thread. When the ring is full, new events are dropped instead
+// of blocking the program, and so is the rest of every call they start,
+// so that calls and their ends stay paired. Once there is room again a
+// DROPPED event records the gap and the earlier calls that ended in it.
+class TraceBuffer {
+public:
+    void record(TraceEvent::Kind kind, size_t line, int value){
+        unsigned position = head.load(std::memory_order_relaxed);
+        unsigned used = position - tail.load(std::memory_order_acquire);
+        if (lost) {
+            if (skipped || used > capacity - 2) {
+                drop(kind);
+                return;
+            }
+            write(position++, lostTime, TraceEvent::DROPPED, lostReturns, lost);
+            lost = 0;
+            lostReturns = 0;
+        } else if (used == capacity) {
+            lostTime = now();
+            drop(kind);
+            return;
+        }
+        write(position, now(), kind, line, value);
+        head.store(position + 1, std::memory_order_release);
+    }
+
+    // Number of the name of function in the trace.
+    int nameOf(FunDef const &function);
+
+private:
+    friend class TraceRecorder;
+
+    TraceRecorder &recorder;
+    unsigned id;
+    std::chrono::steady_clock::time_point start;
+    // A power of two.
+    unsigned capacity;
+    vector<TraceEvent> events;
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+    map<FunDef const *, int> names;
+
+    // The gap being dropped, if lost is not 0: calls started in it and
+    // not ended yet, and earlier calls that ended in it. Only the final
+    // flush reads these from another thread, once the program is done.
+    unsigned lost;
+    unsigned skipped;
+    unsigned lostReturns;
+    unsigned long long lostTime;
+
+    TraceBuffer(TraceRecorder &recorder, unsigned id, std::chrono::steady_clock::time_point start, unsigned capacity);
+
+    unsigned long long now() const{
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void write(unsigned position, unsigned long long time, TraceEvent::Kind kind, size_t line, int value){
+        TraceEvent &event = events[position & (capacity - 1)];
+        event.stamp = time << 8 | kind;
+        event.line = line;
+        event.value = value;
+    }
+
+    void drop(TraceEvent::Kind kind){
+        ++lost;
+        if (kind == TraceEvent::CALL) ++skipped;
+        else if (kind != TraceEvent::RETURN && kind != TraceEvent::UNWIND) return;
+        else if (skipped) --skipped;
+        else ++lostReturns;
+    }
+};
+
+// Writes the events of any number of TraceBuffers to one file from a
+// background thread, every flushMillis and when destroyed. Each buffer
+// holds bufferEvents, a power of two, until written.
+class TraceRecorder {
+public:
+    explicit TraceRecorder(string const &path, unsigned flushMillis = 10, unsigned bufferEvents = 1 << 18);
+    ~TraceRecorder();
+
+    bool isOpen() const{
+        return out.is_open();
+    }
+
+    // The buffer belongs to the recorder and must be written by one
+    // thread at a time.
+    TraceBuffer *attach();
+
+private:
+    friend class TraceBuffer;
+
+    std::ofstream out;
+    unsigned flushMillis;
+    unsigned bufferEvents;
+    std::chrono::steady_clock::time_point start;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    vector<shared_ptr<TraceBuffer> > buffers;
+    vector<string> names;
+    map<string, int> nameIds;
+    size_t namesWritten;
+    bool stopping;
+    std::thread flusher;
+
+    int intern(string const &name);
+    void run();
+    void flush(bool final);
+    void writeChunk(TraceChunk::Type type, unsigned buffer, unsigned size, void const *data, size_t bytes);
+
+    TraceRecorder(TraceRecorder const &);
+    TraceRecorder &operator=(TraceRecorder const &);
+};
+
+#endif // TRACE_H
@@ -0,0 +1,221 @@
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ifstream;
+using std::map;
+using std::ostream;
+using std::string;
+using std::vector;
+
+// One chunk of the trace, in file order.
+struct Record {
+    TraceChunk chunk;
+    vector<TraceEvent> events;
+};
+
+static bool load(ifstream &in, vector<Record> &records, vector<string> &names){
+    TraceHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.magic, traceMagic, sizeof(header.magic)) != 0) {
+        cerr << "Not a PP trace" << endl;
+        return false;
+    }
+    if (header.version < 1 || header.version > traceVersion || header.eventSize != sizeof(TraceEvent)) {
+        cerr << "Unsupported trace version " << header.version << endl;
+        return false;
+    }
+
+    Record record;
+    while (in.read(reinterpret_cast<char *>(&record.chunk), sizeof(record.chunk))) {
+        switch (record.chunk.type) {
+        case TraceChunk::EVENTS:
+            record.events.resize(record.chunk.size);
+            if (record.chunk.size && !in.read(reinterpret_cast<char *>(&record.events[0]), record.chunk.size * sizeof(TraceEvent))) {
+                cerr << "Truncated trace" << endl;
+                return false;
+            }
+            records.push_back(record);
+            break;
+        case TraceChunk::NAME: {
+            string name(record.chunk.size, '\0');
+            if (record.chunk.size && !in.read(&name[0], record.chunk.size)) {
+                cerr << "Truncated trace" << endl;
+                return false;
+            }
+            if (names.size() <= record.chunk.buffer) names.resize(record.chunk.buffer + 1);
+            names[record.chunk.buffer] = name;
+            break;
+        }
+        case TraceChunk::DROPPED:
+            record.events.clear();
+            records.push_back(record);
+            break;
+        default:
+            cerr << "Corrupt trace" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static string nameOf(vector<string> const &names, int id){
+    if (id >= 0 && static_cast<size_t>(id) < names.size()) return names[id];
+    return "?";
+}
+
+static void writeText(vector<Record> const &records, vector<string> const &names, ostream &out){
+    for (size_t r = 0; r != records.size(); ++r) {
+        Record const &record = records[r];
+        if (record.chunk.type == TraceChunk::DROPPED) {
+            out << "[" << record.chunk.buffer << "] dropped " << record.chunk.size << " events" << endl;
+            continue;
+        }
+        for (size_t i = 0; i != record.events.size(); ++i) {
+            TraceEvent const &event = record.events[i];
+            out << "[" << record.chunk.buffer << "] " << event.getTime() << "ns ";
+            if (event.getKind() == TraceEvent::DROPPED) {
+                out << "dropped " << event.value << " events ending " << event.line << " calls" << endl;
+                continue;
+            }
+            out << "line " << event.line << ": ";
+            switch (event.getKind()) {
+            case TraceEvent::CALL: out << "call " << nameOf(names, event.value); break;
+            case TraceEvent::RETURN: out << "return " << event.value; break;
+            case TraceEvent::IF: out << "if " << (event.value ? "taken" : "skipped"); break;
+            case TraceEvent::WHILE: out << "while " << (event.value ? "continues" : "exits"); break;
+            case TraceEvent::READ: out << "read " << event.value; break;
+            case TraceEvent::PRINT: out << "print " << event.value; break;
+            case TraceEvent::UNWIND: out << "unwind"; break;
+            default: out << "unknown event"; break;
+            }
+            out << endl;
+        }
+    }
+}
+
+static void writeJsonString(string const &text, ostream &out){
+    out << '"';
+    for (size_t i = 0; i != text.size(); ++i) {
+        if (text[i] == '"' || text[i] == '\\') out << '\\';
+        out << text[i];
+    }
+    out << '"';
+}
+
+// Calls begun and not yet ended in one buffer, and the time of its last
+// event.
+struct Thread {
+    size_t open;
+    unsigned long long time;
+
+    Thread(): open(0), time(0) {}
+};
+
+// Starts an event of tid at time, in microseconds.
+static void writeEvent(unsigned tid, unsigned long long time, bool &first, ostream &out){
+    out << (first ? "" : ",") << "\n{\"pid\": 1, \"tid\": " << tid
+        << ", \"ts\": " << time / 1000 << "." << time / 100 % 10 << time / 10 % 10 << time % 10;
+    first = false;
+}
+
+static void writeDropped(unsigned tid, unsigned long long time, unsigned events, bool &first, ostream &out){
+    writeEvent(tid, time, first, out);
+    out << ", \"ph\": \"i\", \"s\": \"t\", \"name\": \"dropped\", \"args\": {\"events\": " << events << "}}";
+}
+
+// Ends count of the open calls of tid, which were lost in a gap.
+static void writeLostEnds(unsigned tid, Thread &thread, size_t count, bool &first, ostream &out){
+    for (; count && thread.open; --count, --thread.open) {
+        writeEvent(tid, thread.time, first, out);
+        out << ", \"ph\": \"E\", \"args\": {\"dropped\": true}}";
+    }
+}
+
+// Chrome trace event format: calls are duration events, everything else
+// is an instant event. Every B gets its E: calls still open at the end
+// of the trace end with the last event of their thread, and ends without
+// a call, which a full ring of version 2 could leave, are skipped.
+static void writeJson(vector<Record> const &records, vector<string> const &names, ostream &out){
+    static char const *const instants[] = {0, 0, "if", "while", "read", "print"};
+    out << "{\"traceEvents\": [";
+    bool first = true;
+    map<unsigned, Thread> threads;
+    for (size_t r = 0; r != records.size(); ++r) {
+        Record const &record = records[r];
+        unsigned tid = record.chunk.buffer;
+        Thread &thread = threads[tid];
+        for (size_t i = 0; i != record.events.size(); ++i) {
+            TraceEvent const &event = record.events[i];
+            thread.time = event.getTime();
+            switch (event.getKind()) {
+            case TraceEvent::CALL:
+                writeEvent(tid, thread.time, first, out);
+                out << ", \"ph\": \"B\", \"name\": ";
+                writeJsonString(nameOf(names, event.value), out);
+                out << ", \"args\": {\"line\": " << event.line << "}}";
+                ++thread.open;
+                break;
+            case TraceEvent::RETURN:
+            case TraceEvent::UNWIND:
+                if (!thread.open) break;
+                writeEvent(tid, thread.time, first, out);
+                if (event.getKind() == TraceEvent::RETURN)
+                    out << ", \"ph\": \"E\", \"args\": {\"value\": " << event.value << "}}";
+                else
+                    out << ", \"ph\": \"E\", \"args\": {\"unwound\": true}}";
+                --thread.open;
+                break;
+            case TraceEvent::DROPPED:
+                writeDropped(tid, thread.time, event.value, first, out);
+                writeLostEnds(tid, thread, event.line, first, out);
+                break;
+            default:
+                writeEvent(tid, thread.time, first, out);
+                out << ", \"ph\": \"i\", \"s\": \"t\", \"name\": \""
+                    << (event.getKind() <= TraceEvent::PRINT ? instants[event.getKind()] : "unknown")
+                    << "\", \"args\": {\"line\": " << event.line << ", \"value\": " << event.value << "}}";
+                break;
+            }
+        }
+        if (record.chunk.type == TraceChunk::DROPPED)
+            writeDropped(tid, thread.time, record.chunk.size, first, out);
+    }
+    for (map<unsigned, Thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        writeLostEnds(it->first, it->second, it->second.open, first, out);
+    out << "\n]}" << endl;
+}
+
+int main(int args, char const *argv[])
+{
+    bool json = false;
+    char const *fileName = 0;
+    for (int i = 1; i < args; ++i) {
+        if (string(argv[i]) == "--json") json = true;
+        else fileName = argv[i];
+    }
+
+    if (!fileName){
+        cout << "Usage: " << argv[0] << " [--json] <TRACE_FILE_NAME>" << endl;
+        return 1;
+    }
+
+    ifstream in(fileName, std::ios::binary);
+    if(!in.good()){
+        cout << "File " << fileName << " does not exist" << endl;
+        return 2;
+    }
+
+    vector<Record> records;
+    vector<string> names;
+    if (!load(in, records, names)) return 3;
+    if (json) writeJson(records, names, cout);
+    else writeText(records, names, cout);
+    return 0;
+}
@@ -16,6 +16,10 @@ public:
     virtual int visit(class Return const &node) = 0;
     virtual int visit(class Read const &node) = 0;
     virtual int visit(class Print const &node) = 0;
+    virtual int visit(class Index const &node) = 0;
+    virtual int visit(class IndexAssign const &node) = 0;
+    virtual int visit(class ArrayOp const &node) = 0;
+    virtual int visit(class InlinedCall const &node) = 0;
 };
 
 #endif // VISITOR_H
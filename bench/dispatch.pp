@@ -0,0 +1,54 @@
+# Input of dispatchBench: a mix of every kind of statement, so the walk
+# spends its time on dispatch rather than on any one node.
+def gcd(a, b):
+    while b != 0:
+        t = b
+        b = a - (a / b) * b
+        a = t
+    end
+    return a
+end
+
+def collatz(n):
+    steps = 0
+    while n != 1:
+        half = n / 2
+        if n == 2 * half:
+            n = half
+        end
+        if n != half:
+            n = 3 * n + 1
+        end
+        steps = steps + 1
+    end
+    return steps
+end
+
+def poly(x):
+    return ((3 * x + 2) * x - 7) * x + 11 * (x - 1) / (x * x + 1)
+end
+
+def tabulate(values, count):
+    i = 0
+    while i < count:
+        values[i] = poly(i) - gcd(i + 12, 18) * collatz(i + 1)
+        i = i + 1
+    end
+    return sum(values)
+end
+
+read n
+values = array(n)
+print tabulate(values, n)
+total = 0
+i = 0
+while i < n:
+    if values[i] > 0:
+        total = total + values[i] * (i - n / 2)
+    end
+    if values[i] <= 0:
+        total = total - values[i] / (i + 1)
+    end
+    i = i + 1
+end
+print total + len(values) - gcd(n, 36) + poly(-n) * collatz(n + 7)
@@ -0,0 +1,169 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include "parser.h"
+#include "staticVisitor.h"
+
+using std::cout;
+using std::endl;
+
+// Folds every node of a tree into one number. Base supplies the
+// dispatch: Visitor, where each child costs accept() and a virtual
+// visit(), or StaticVisitor, where it costs one switch. The visit()
+// bodies are the same for both, so only the dispatch differs.
+template <class Base, class Walker>
+class Checksum: public Base {
+public:
+    int visit(Program const &node){ return list(node.getInstructions()); }
+    int visit(FunDef const &node){ return list(node.getInstructions()); }
+    int visit(VarDef const &node){ return child(node.getExp()); }
+    int visit(Num const &node){ return node.getValue(); }
+    int visit(Var const &node){ return node.getName().size(); }
+    int visit(FunCall const &node){ return list(node.getParams()); }
+    int visit(Operator const &node){
+        unsigned left = child(node.getLeft());
+        unsigned right = child(node.getRight());
+        switch (node.getOperation()) {
+        case '+': return left + right;
+        case '-': return left - right;
+        case '*': return left * right;
+        default: return left ^ right;
+        }
+    }
+    int visit(Cond const &node){ return child(node.getLeft()) - child(node.getRight()); }
+    int visit(If const &node){ return child(node.getCond()) + list(node.getInstructions()); }
+    int visit(While const &node){ return child(node.getCond()) + list(node.getInstructions()); }
+    int visit(Return const &node){ return child(node.getExp()); }
+    int visit(Read const &){ return 1; }
+    int visit(Print const &node){ return child(node.getExp()); }
+    int visit(Index const &node){ return child(node.getIndex()); }
+    int visit(IndexAssign const &node){ return child(node.getIndex()) + child(node.getExp()); }
+    int visit(ArrayOp const &node){ return list(node.getParams()); }
+    int visit(InlinedCall const &node){ return list(node.getArgs()) + child(node.getBody()); }
+
+private:
+    int child(InstructionPtr const &node){
+        return node ? static_cast<Walker &>(*this).walk(*node) : 0;
+    }
+
+    int list(Instructions const &nodes){
+        unsigned sum = 0;
+        for (size_t i = 0; i != nodes.size(); ++i)
+            sum = sum * 31 + child(nodes[i]);
+        return sum;
+    }
+};
+
+class VirtualWalker: public Checksum<Visitor, VirtualWalker> {
+public:
+    int walk(Instruction const &node){
+        return const_cast<Instruction &>(node).accept(*this);
+    }
+};
+
+class SwitchWalker: public Checksum<StaticVisitor<SwitchWalker>, SwitchWalker> {
+public:
+    int walk(Instruction const &node){
+        return dispatch(node);
+    }
+};
+
+template <class Walker>
+static unsigned walkProgram(Walker &walker, ProgramContext const &program){
+    unsigned sum = walker.walk(*program.entryPoint);
+    for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it)
+        sum = sum * 31 + walker.walk(*it->second);
+    return sum;
+}
+
+// Best of several rounds, in nanoseconds per node.
+template <class Walker>
+static double time(ProgramContext const &program, size_t nodes, int walks, unsigned &checksum){
+    Walker walker;
+    double best = 0;
+    for (int round = 0; round != 5; ++round) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        unsigned sum = 0;
+        for (int i = 0; i != walks; ++i)
+            sum += walkProgram(walker, program);
+        double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        checksum = sum;
+        if (round == 0 || nanoseconds < best) best = nanoseconds;
+    }
+    return best / (static_cast<double>(nodes) * walks);
+}
+
+// Counts the nodes of the program.
+class Counter: public StaticVisitor<Counter> {
+public:
+    size_t nodes;
+
+    Counter(): nodes(0) {}
+
+    int walk(Instruction const &node){
+        ++nodes;
+        return dispatch(node);
+    }
+
+    int visit(Program const &node){ return list(node.getInstructions()); }
+    int visit(FunDef const &node){ return list(node.getInstructions()); }
+    int visit(VarDef const &node){ return child(node.getExp()); }
+    int visit(Num const &){ return 0; }
+    int visit(Var const &){ return 0; }
+    int visit(FunCall const &node){ return list(node.getParams()); }
+    int visit(Operator const &node){ return child(node.getLeft()) + child(node.getRight()); }
+    int visit(Cond const &node){ return child(node.getLeft()) + child(node.getRight()); }
+    int visit(If const &node){ return child(node.getCond()) + list(node.getInstructions()); }
+    int visit(While const &node){ return child(node.getCond()) + list(node.getInstructions()); }
+    int visit(Return const &node){ return child(node.getExp()); }
+    int visit(Read const &){ return 0; }
+    int visit(Print const &node){ return child(node.getExp()); }
+    int visit(Index const &node){ return child(node.getIndex()); }
+    int visit(IndexAssign const &node){ return child(node.getIndex()) + child(node.getExp()); }
+    int visit(ArrayOp const &node){ return list(node.getParams()); }
+    int visit(InlinedCall const &node){ return list(node.getArgs()) + child(node.getBody()); }
+
+private:
+    int child(InstructionPtr const &node){
+        return node ? walk(*node) : 0;
+    }
+
+    int list(Instructions const &nodes){
+        for (size_t i = 0; i != nodes.size(); ++i) child(nodes[i]);
+        return 0;
+    }
+};
+
+int main(int args, char const *argv[])
+{
+    char const *fileName = args > 1 ? argv[1] : "dispatch.pp";
+    int walks = args > 2 ? atoi(argv[2]) : 20000;
+
+    std::ifstream in(fileName);
+    if (!in.good()) {
+        cout << "File " << fileName << " does not exist" << endl;
+        return 2;
+    }
+    in >> std::noskipws;
+    Parser parser(in);
+    ProgramContext program = parser.parse();
+
+    Counter counter;
+    walkProgram(counter, program);
+
+    unsigned virtualSum = 0;
+    unsigned switchSum = 0;
+    double virtualTime = time<VirtualWalker>(program, counter.nodes, walks, virtualSum);
+    double switchTime = time<SwitchWalker>(program, counter.nodes, walks, switchSum);
+    if (virtualSum != switchSum) {
+        cout << "Checksums differ: " << virtualSum << " and " << switchSum << endl;
+        return 1;
+    }
+
+    cout << fileName << ": " << counter.nodes << " nodes, " << walks << " walks" << endl;
+    cout << "  accept() + virtual visit(): " << virtualTime << " ns/node" << endl;
+    cout << "  StaticVisitor::dispatch():  " << switchTime << " ns/node" << endl;
+    cout << "  speedup: " << virtualTime / switchTime << "x" << endl;
+    return 0;
+}
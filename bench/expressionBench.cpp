@@ -0,0 +1,90 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdlib>
+#include "parser.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// One print of a generated expression with the given number of terms,
+// cycling through the four operators the way generated scripts do.
+static string expression(int terms){
+    static char const operators[] = {'+', '*', '-', '/'};
+    std::ostringstream source;
+    source << "print 1";
+    for (int i = 1; i != terms; ++i)
+        source << ' ' << operators[i % 4] << ' ' << 1 + i % 9;
+    source << '\n';
+    return source.str();
+}
+
+// Longest chain of nested nodes, walked without recursion so that deep
+// trees do not overflow the stack of the benchmark itself.
+static size_t depth(InstructionPtr const &root){
+    size_t deepest = 0;
+    vector<std::pair<Instruction const *, size_t> > pending(1, std::make_pair(root.get(), size_t(1)));
+    while (!pending.empty()) {
+        Instruction const *node = pending.back().first;
+        size_t level = pending.back().second;
+        pending.pop_back();
+        if (!node) continue;
+        if (level > deepest) deepest = level;
+        switch (node->getKind()) {
+        case Instruction::PROGRAM: {
+            Instructions const &children = static_cast<Program const &>(*node).getInstructions();
+            for (size_t i = 0; i != children.size(); ++i) pending.push_back(std::make_pair(children[i].get(), level + 1));
+            break;
+        }
+        case Instruction::PRINT:
+            pending.push_back(std::make_pair(static_cast<Print const &>(*node).getExp().get(), level + 1));
+            break;
+        case Instruction::OPERATOR:
+            pending.push_back(std::make_pair(static_cast<Operator const &>(*node).getLeft().get(), level + 1));
+            pending.push_back(std::make_pair(static_cast<Operator const &>(*node).getRight().get(), level + 1));
+            break;
+        default:
+            break;
+        }
+    }
+    return deepest;
+}
+
+// Best of several parses, in milliseconds.
+static double time(string const &source, size_t &treeDepth){
+    double best = 0;
+    for (int round = 0; round != 5; ++round) {
+        std::istringstream in(source);
+        in >> std::noskipws;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Parser parser(in);
+        ProgramContext program = parser.parse();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        treeDepth = depth(program.entryPoint);
+        if (round == 0 || milliseconds < best) best = milliseconds;
+    }
+    return best;
+}
+
+int main(int args, char const *argv[])
+{
+    vector<int> sizes;
+    for (int i = 1; i < args; ++i) sizes.push_back(atoi(argv[i]));
+    if (sizes.empty()) {
+        sizes.push_back(100000);
+        sizes.push_back(400000);
+    }
+
+    for (size_t i = 0; i != sizes.size(); ++i) {
+        size_t treeDepth = 0;
+        double milliseconds = time(expression(sizes[i]), treeDepth);
+        cout << sizes[i] << " terms: parsed in " << milliseconds << " ms ("
+             << milliseconds * 1e6 / sizes[i] << " ns/term), tree depth " << treeDepth << endl;
+    }
+    return 0;
+}
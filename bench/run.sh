@@ -0,0 +1,23 @@
+#!/bin/sh
+# Microbenchmarks of the engine.
+#
+#     bench/run.sh
+#
+# builds each bench/NAME.cpp with $CXX (default c++) against the parser
+# and runs it from this directory, so it finds its .pp input.
+
+cd "$(dirname "$0")" || exit 2
+source=../PPInterpreter
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:--std=c++11 -O2 -pthread}
+
+work=$(mktemp -d) || exit 2
+trap 'rm -rf "$work"' EXIT
+
+status=0
+for bench in *.cpp; do
+    name=${bench%.cpp}
+    $CXX $CXXFLAGS -I"$source" "$bench" "$source/parser.cpp" "$source/lexer.cpp" -o "$work/$name" || exit 2
+    "$work/$name" || status=1
+done
+exit $status
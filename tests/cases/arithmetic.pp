@@ -0,0 +1,12 @@
+# Precedence, unary minus, and arithmetic that wraps around at 32 bits.
+print 2 + 3 * 4
+print (2 + 3) * 4
+print -5 + 2
+print --5
+print -(3 * 4)
+print 7 / 2
+print -7 / 2
+print 2147483647 + 1
+print 65536 * 65536 + 3
+x = 0 - 2147483647 - 1
+print x / -1
@@ -0,0 +1,18 @@
+a = array(5)
+b = array(5)
+fill(a, 3)
+i = 0
+while i < len(b)
+    b[i] = i * i
+    i = i + 1
+end
+c = array(5)
+vadd(c, a, b)
+print sum(c)
+vmul(c, a, b)
+print c[4]
+copy(a, c)
+print a[2]
+print len(array(0))
+huge = array(2000000000)
+print 0
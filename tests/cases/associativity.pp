@@ -0,0 +1,14 @@
+print 10 - 3 - 2
+print 100 / 10 / 5
+print 2 - 3 + 4
+print 2 + 3 - 4 - 5
+print 64 / 4 * 2
+print 64 * 2 / 4 / 8
+print 1 - 2 * 3 - 4
+print 20 - 12 / 2 / 3
+print (10 - 3) - 2
+print 10 - (3 - 2)
+print 100 / (10 / 5)
+x = 30
+print x - x / 3 - 4 * 2 - 1
+print 7 - 0 - 1 - 1 - 1 - 1 - 1 - 1 - 1 - 1 - 1
@@ -0,0 +1,21 @@
+i = 0
+evens = 0
+while i < 10:
+    if i == 2 * (i / 2):
+        evens = evens + 1
+    end
+    if i >= 8:
+        print i
+    end
+    i = i + 1
+end
+print evens
+if 1 != 1:
+    print 0
+end
+if 3 <= 3:
+    print 1
+end
+if 4 > 3:
+    print 2
+end
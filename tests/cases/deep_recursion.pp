@@ -0,0 +1,11 @@
+# Recursion is bounded by the native stack, not by a count of calls:
+# 5000 frames is past what a fixed limit of a few thousand would allow, yet
+# well inside 8 MB in unoptimized and sanitizer builds. Overflow itself is
+# covered by native_stack_overflow and unit/embeddingTest.
+def s(n):
+    if n == 0:
+        return 0
+    end
+    return n + s(n - 1)
+end
+print s(5000)
@@ -0,0 +1,17 @@
+def four()
+    return 2 * 2
+end
+
+print (1 + 2) * 4 - 6 / 4
+print 0 - 2147483647 - 1
+print 2147483647 + 1
+print four() * (10 - four())
+x = 3
+print x * (2 + 3) - (8 / 2)
+if 1 < 2
+    print 7
+end
+while 3 < 2
+    print 8
+end
+print 1 / (3 - 3)
@@ -0,0 +1,28 @@
+def fact(n):
+    if n <= 1:
+        return 1
+    end
+    return n * fact(n - 1)
+end
+
+def fib(n):
+    if n < 2:
+        return n
+    end
+    return fib(n - 1) + fib(n - 2)
+end
+
+def largest(a, b, c):
+    m = a
+    if b > m:
+        m = b
+    end
+    if c > m:
+        m = c
+    end
+    return m
+end
+
+print fact(10)
+print fib(20)
+print largest(4, fact(3), 5)
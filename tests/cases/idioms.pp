@@ -0,0 +1,61 @@
+n = 100000
+s = 0
+i = 0
+while i < n
+    s = s + i
+    i = i + 1
+end
+print s
+print i
+
+s = 7
+i = 1
+while i <= 1000
+    s = i * i * 3 - i + s
+    i = i + 1
+end
+print s
+
+s = 0
+i = -50
+while i < 50
+    s = s - i * i * i
+    i = i + 1
+end
+print s
+
+s = 0
+i = 0
+while i < 70000
+    s = s + i * i * i * i
+    i = i + 1
+end
+print s
+
+s = 0
+i = 10
+while i < 5
+    s = s + i
+    i = i + 1
+end
+print s
+print i
+
+def sq(x)
+    return x * x - 1
+end
+
+s = 0
+i = 0
+while i < 3000
+    s = s + sq(i)
+    i = i + 1
+end
+print s
+
+s = 0
+i = 0
+while i < 20
+    s = s + i * k
+    i = i + 1
+end
@@ -0,0 +1,41 @@
+def double(x)
+    return x + x
+end
+
+def twice(x)
+    return double(double(x))
+end
+
+def shadow(i)
+    s = i * 10
+    return s + i
+end
+
+def safediv(a, b)
+    return a / b
+end
+
+def count(n)
+    if n == 0
+        return 0
+    end
+    return 1 + count(n - 1)
+end
+
+s = 1
+i = 2
+print twice(i)
+print shadow(i + s)
+print s
+print i
+total = 0
+j = 0
+while j < 2000
+    total = total + double(j) - shadow(j)
+    j = j + 1
+end
+print total
+print count(50)
+print safediv(100, 7)
+print safediv(1, i - 2)
+print 1
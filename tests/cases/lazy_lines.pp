@@ -0,0 +1,20 @@
+def unused(x)
+    return x + 1
+end
+
+def half(x)
+    y = x / 2
+    return y
+end
+
+def broken(x)
+    if x > 0
+        z = x - 1
+    end
+    return x / 0
+end
+
+print half(10)
+print half(7)
+print broken(3)
+print 4
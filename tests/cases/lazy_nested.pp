@@ -0,0 +1,18 @@
+def outer(n)
+    s = 0
+    while n > 0
+        s = s + inner(n)
+        n = n - 1
+    end
+    return s
+end
+
+def inner(k)
+    if k == 2
+        return missing
+    end
+    return k
+end
+
+print outer(1)
+print outer(5)
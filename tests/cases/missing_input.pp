@@ -0,0 +1,4 @@
+read a
+print a
+read b
+print b
@@ -0,0 +1,10 @@
+# Generated code checks the native stack as the interpreter does, so its
+# recursion is not held to a count of calls and still fails cleanly.
+def s(n):
+    if n == 0:
+        return 0
+    end
+    return s(n - 1) * 2 / 2 + 1
+end
+print s(50000)
+print s(100000000)
@@ -0,0 +1,10 @@
+# Each call nests 40 operators deep, so the native stack runs out long
+# before the calls would reach any fixed depth limit.
+def r(n):
+    if n == 0:
+        return 0
+    end
+    return 1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (1 + (r(n - 1)))))))))))))))))))))))))))))))))))))))))
+end
+print r(100)
+print r(9000)
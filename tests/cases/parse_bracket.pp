@@ -0,0 +1,4 @@
+# An index needs its closing bracket.
+a = array(3)
+print a[1
+print 2
@@ -0,0 +1,3 @@
+# A def must be closed by end, also when its body is parsed lazily.
+def f(x):
+    return x
@@ -0,0 +1,3 @@
+# An index needs an expression.
+a = array(3)
+print a[]
@@ -0,0 +1,3 @@
+# An operator with nothing after it is a parse error.
+x = 2 *
+print x
@@ -0,0 +1,3 @@
+# A parenthesis left open is a parse error.
+x = (2 + 3
+print x
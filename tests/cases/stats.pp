@@ -0,0 +1,16 @@
+# Allocates in every --stats phase: calls to inline and a loop to recognize.
+def square(x):
+    return x * x
+end
+
+def sumSquares(n):
+    s = 0
+    i = 0
+    while i < n
+        s = s + square(i)
+        i = i + 1
+    end
+    return s
+end
+
+print sumSquares(100)
@@ -0,0 +1,18 @@
+def total(n)
+    s = 0
+    i = 0
+    while i < n
+        s = s + i
+        i = i + 1
+    end
+    return s
+end
+print total(10000)
+read n
+s = 0
+i = 1
+while i < n
+    s = s + i * 3
+    i = i + 1
+end
+print s
@@ -0,0 +1,24 @@
+def term(x)
+    return x * 2
+end
+
+def total(n)
+    s = 0
+    i = 0
+    while i < n
+        s = s + term(i)
+        i = i + 1
+    end
+    return s
+end
+
+print total(5000)
+
+def term(x)
+    if x - x / 1000 * 1000 == 0
+        print x
+    end
+    return x
+end
+
+print total(5000)
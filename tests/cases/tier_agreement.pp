@@ -0,0 +1,50 @@
+def step(x)
+    if x / 2 * 2 == x
+        return x / 2
+    end
+    return 3 * x + 1
+end
+
+def steps(n)
+    count = 0
+    while n > 1
+        n = step(n)
+        count = count + 1
+    end
+    return count
+end
+
+def fib(n)
+    if n < 2
+        return n
+    end
+    return fib(n - 1) + fib(n - 2)
+end
+
+longest = 0
+best = 0
+i = 1
+while i < 3000
+    c = steps(i)
+    if c > longest
+        longest = c
+        best = i
+    end
+    i = i + 1
+end
+print best
+print longest
+
+print fib(20)
+
+total = 0
+row = 0
+while row < 200
+    col = 0
+    while col < 200
+        total = total + row * col - col / 3
+        col = col + 1
+    end
+    row = row + 1
+end
+print total
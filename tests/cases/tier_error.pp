@@ -0,0 +1,11 @@
+def ratio(a, b)
+    return a / b
+end
+
+i = 3000
+s = 0
+while i > -10
+    s = s + ratio(100000, i)
+    i = i - 1
+end
+print s
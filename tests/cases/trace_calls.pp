@@ -0,0 +1,28 @@
+def inner(x)
+    if x > 2
+        print x
+    end
+    return x * 2
+end
+
+def outer(n)
+    s = 0
+    i = 0
+    while i < n
+        s = s + inner(i)
+        i = i + 1
+    end
+    return s
+end
+
+def broken(x)
+    return inner(x) / (x - x)
+end
+
+def deeper(x)
+    return broken(x) + 1
+end
+
+read n
+print outer(n)
+print deeper(n)
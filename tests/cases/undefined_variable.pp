@@ -0,0 +1,6 @@
+def f(x):
+    return x + y
+end
+y = 1
+print y
+print f(2)
@@ -0,0 +1,140 @@
+#!/bin/sh
+# Golden-output tests for PPInterpreter.
+#
+#     tests/run.sh
+#
+# builds the interpreter, pptracedecode and the unit tests with $CXX
+# (default c++) from the sources listed in the qmake files, then runs them.
+# PP and PPTRACEDECODE name prebuilt binaries to use instead.
+#
+# cases/NAME.pp runs once per line of cases/NAME.modes, or once without
+# flags if there is no such file. Every run must print cases/NAME.out:
+# its stdout and stderr, then "exit N" if the status is not 0. Standard
+# input comes from cases/NAME.in when it exists. A mode is a list of
+# interpreter flags, or one of these words:
+#
+#     native   builds the program with --build-native and runs the result
+#     trace    also runs with --trace; the decoded events, with times cut
+#              out, must match cases/NAME.trace, and every begin event of
+#              the JSON form must have its end
+#     stats    runs with --stats, which writes its report to stderr; it must
+#              have the phases lex, parse, inline, idioms and execute, and
+#              every phase must have counted some allocations
+#
+# unit/NAME.cpp is linked against the engine and must exit with 0.
+
+cd "$(dirname "$0")" || exit 2
+tests=$(pwd)
+source=$(cd ../PPInterpreter && pwd)
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:--std=c++11 -O2 -pthread}
+
+work=$(mktemp -d) || exit 2
+trap 'rm -rf "$work"' EXIT
+
+compile(){
+    $CXX $CXXFLAGS -I"$source" "$@"
+}
+
+# qmake lists one source per line, as "$$PWD/name.cpp" in engine.pri.
+engine=$(sed -n 's/.*\$\$PWD\/\([A-Za-z]*\.cpp\).*/\1/p' "$source/engine.pri")
+application=$(sed -n 's/^[A-Z +=]*\([A-Za-z]*\.cpp\).*/\1/p' "$source/PPInterpreter.pro")
+
+mkdir "$work/engine"
+for file in $engine; do
+    compile -c "$source/$file" -o "$work/engine/${file%.cpp}.o" &
+done
+wait
+for file in $engine; do
+    [ -f "$work/engine/${file%.cpp}.o" ] || { echo "cannot build $file"; exit 2; }
+done
+
+if [ -z "$PP" ]; then
+    PP=$work/PPInterpreter
+    (cd "$source" && compile $application "$work"/engine/*.o -o "$PP") || exit 2
+fi
+if [ -z "$PPTRACEDECODE" ]; then
+    PPTRACEDECODE=$work/pptracedecode
+    compile "$source/traceDecode.cpp" -o "$PPTRACEDECODE" || exit 2
+fi
+
+passed=0
+failed=0
+
+pass(){
+    passed=$((passed + 1))
+}
+
+fail(){
+    failed=$((failed + 1))
+    echo "FAIL $1"
+    [ -n "$2" ] && cat "$2"
+}
+
+# Runs one case in one mode and prints what it produced.
+run(){
+    name=$1
+    shift
+    input=/dev/null
+    [ -f "$name.in" ] && input=$name.in
+    if [ "$1" = stats ]; then
+        "$PP" --stats "$name.pp" < "$input" 2> "$work/stats"
+    elif [ "$1" = native ]; then
+        # The space, dollar and quote check that paths reach the compiler intact.
+        mkdir -p "$work/native \$build's"
+        "$PP" --build-native "$work/native \$build's/$name" "$name.pp" > "$work/build.log" 2>&1 || {
+            cat "$work/build.log"
+            echo "exit build"
+            return
+        }
+        "$work/native \$build's/$name" < "$input" 2>&1
+    else
+        "$PP" "$@" "$name.pp" < "$input" 2>&1
+    fi
+    status=$?
+    [ $status -ne 0 ] && echo "exit $status"
+}
+
+cd "$tests/cases" || exit 2
+for program in *.pp; do
+    name=${program%.pp}
+    modes=$name.modes
+    [ -f "$modes" ] || { echo > "$work/modes"; modes=$work/modes; }
+    while IFS= read -r mode; do
+        label="$name [$mode]"
+        if [ "$mode" = trace ]; then
+            run "$name" --trace "$work/trace" < /dev/null | sed "s|$PP|PPInterpreter|" > "$work/actual"
+        else
+            run "$name" $mode < /dev/null | sed "s|$PP|PPInterpreter|" > "$work/actual"
+        fi
+        if diff -u "$name.out" "$work/actual" > "$work/diff"; then pass; else fail "$label" "$work/diff"; fi
+        if [ "$mode" = stats ]; then
+            counted=$(grep -o '"allocations": [0-9]*' "$work/stats" | grep -vc ': 0$')
+            uncounted=$(grep -o '"allocations": [0-9]*' "$work/stats" | grep -c ': 0$')
+            if [ "$counted" -gt 0 ] && [ "$uncounted" = 0 ]; then pass; else fail "$label: allocations not counted" "$work/stats"; fi
+            phases=$(grep -o '"name": "[a-z]*"' "$work/stats" | cut -d'"' -f4 | tr '\n' ' ')
+            if [ "$phases" = "lex parse inline idioms execute " ]; then pass; else fail "$label: phases $phases" "$work/stats"; fi
+        fi
+        [ "$mode" = trace ] || continue
+
+        "$PPTRACEDECODE" "$work/trace" | sed 's/ [0-9]*ns / /' > "$work/events"
+        if diff -u "$name.trace" "$work/events" > "$work/diff"; then pass; else fail "$label events" "$work/diff"; fi
+        "$PPTRACEDECODE" --json "$work/trace" > "$work/json"
+        begins=$(grep -c '"ph": "B"' "$work/json")
+        ends=$(grep -c '"ph": "E"' "$work/json")
+        if [ "$begins" = "$ends" ]; then pass; else fail "$label: $begins begin and $ends end events"; fi
+    done < "$modes"
+done
+
+for test in "$tests"/unit/*.cpp; do
+    [ -f "$test" ] || continue
+    name=$(basename "$test" .cpp)
+    if compile "$test" "$work"/engine/*.o -o "$work/$name" > "$work/log" 2>&1 && "$work/$name" > "$work/log" 2>&1; then
+        pass
+    else
+        fail "unit/$name" "$work/log"
+    fi
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
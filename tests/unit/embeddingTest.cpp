@@ -0,0 +1,107 @@
+#include <pthread.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "engine.h"
+
+// The embedding API must not expose the interpreter.
+#if defined(AST_H) || defined(INTERPRETER_H) || defined(TIERING_H) || defined(TRACE_H)
+#error engine.h includes internal headers
+#endif
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+class Collect: public InputOutput {
+public:
+    vector<int> output;
+
+    bool read(int &){
+        return false;
+    }
+
+    void print(int value){
+        output.push_back(value);
+    }
+};
+
+// A call level that takes a lot of native stack: 40 nested operators.
+static string deepRecursion(int depth){
+    std::ostringstream source;
+    source << "def r(n)\n    if n == 0\n        return 0\n    end\n    return ";
+    for (int i = 0; i != 40; ++i) source << "1 + (";
+    source << "r(n - 1)";
+    for (int i = 0; i != 40; ++i) source << ")";
+    source << "\nend\nprint r(" << depth << ")\n";
+    return source.str();
+}
+
+struct Job {
+    CompiledProgram program;
+    size_t stackSize;
+    // Released before the program.
+    shared_ptr<TierManager> tiering;
+    Collect io;
+    string error;
+};
+
+static void *runJob(void *argument){
+    Job &job = *static_cast<Job *>(argument);
+    RunOptions run;
+    run.stackSize = job.stackSize;
+    run.tiering = job.tiering.get();
+    try {
+        runProgram(job.program, job.io, run);
+    } catch (RuntimeError const &e) {
+        job.error = e.what();
+    }
+    return 0;
+}
+
+// Runs job on a thread with a stack of job.stackSize bytes.
+static bool runOnThread(Job &job){
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, job.stackSize);
+    pthread_t thread;
+    bool started = pthread_create(&thread, &attributes, &runJob, &job) == 0;
+    pthread_attr_destroy(&attributes);
+    if (started) pthread_join(thread, 0);
+    return started;
+}
+
+static int failures = 0;
+
+static void check(bool condition, string const &what){
+    if (condition) return;
+    cout << "failed: " << what << endl;
+    ++failures;
+}
+
+int main()
+{
+    size_t const stackSize = 256 << 10;
+    for (int tier = 0; tier != 2; ++tier) {
+        Job shallow;
+        std::istringstream source(deepRecursion(20));
+        shallow.program = compileProgram(source);
+        shallow.stackSize = stackSize;
+        if (tier) shallow.tiering = createTiering(10, 10);
+        check(runOnThread(shallow), "start a thread");
+        check(shallow.error.empty() && shallow.io.output.size() == 1 && shallow.io.output[0] == 800,
+              "shallow recursion on a small stack");
+
+        // Would run past the end of a 256 KB stack without the limit.
+        Job deep;
+        std::istringstream deepSource(deepRecursion(20000));
+        deep.program = compileProgram(deepSource);
+        deep.stackSize = stackSize;
+        if (tier) deep.tiering = createTiering(10, 10);
+        check(runOnThread(deep), "start a thread");
+        check(deep.error == "call stack overflow", "deep recursion on a small stack fails cleanly");
+    }
+    return failures == 0 ? 0 : 1;
+}
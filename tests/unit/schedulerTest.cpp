@@ -0,0 +1,102 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "scheduler.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static int failures = 0;
+
+static void check(bool condition, string const &what){
+    if (condition) return;
+    cout << "failed: " << what << endl;
+    ++failures;
+}
+
+static CompiledProgram compile(string const &source){
+    std::istringstream in(source);
+    return compileProgram(in);
+}
+
+// A call level that takes a lot of native stack: 40 nested operators.
+static string deepRecursion(int depth){
+    std::ostringstream source;
+    source << "def r(n)\n    if n == 0\n        return 0\n    end\n    return ";
+    for (int i = 0; i != 40; ++i) source << "1 + (";
+    source << "r(n - 1)";
+    for (int i = 0; i != 40; ++i) source << ")";
+    source << "\nend\nprint r(" << depth << ")\n";
+    return source.str();
+}
+
+// More tasks than workers, with a budget small enough to preempt each
+// of them many times.
+static void testPreemption(){
+    CompiledProgram program = compile(
+        "i = 0\ns = 0\nwhile i < 20000\n    s = s + i - i / 7 * 7\n    i = i + 1\nend\nprint s\n");
+    Scheduler scheduler(2, 100);
+    vector<TaskPtr> tasks;
+    for (int i = 0; i != 8; ++i)
+        tasks.push_back(scheduler.spawn(program));
+    scheduler.wait();
+    for (size_t i = 0; i != tasks.size(); ++i) {
+        check(tasks[i]->isFinished(), "preempted task finishes");
+        check(tasks[i]->getError().empty(), "preempted task has no error");
+        check(tasks[i]->getOutput().size() == 1 && tasks[i]->getOutput()[0] == 59997, "preempted task output");
+    }
+}
+
+// Tasks park on read until input arrives or is closed.
+static void testParkedReads(){
+    CompiledProgram program = compile("read a\nread b\nprint a + b\n");
+    Scheduler scheduler(2);
+    vector<TaskPtr> tasks;
+    for (int i = 0; i != 4; ++i)
+        tasks.push_back(scheduler.spawn(program));
+    for (int i = 0; i != 4; ++i)
+        tasks[i]->pushInput(i);
+    for (int i = 0; i != 3; ++i)
+        tasks[i]->pushInput(10 * i);
+    tasks[3]->closeInput();
+    scheduler.wait();
+    for (int i = 0; i != 3; ++i)
+        check(tasks[i]->getOutput().size() == 1 && tasks[i]->getOutput()[0] == 11 * i, "parked task output");
+    check(tasks[3]->getOutput().empty(), "task with closed input prints nothing");
+    check(!tasks[3]->getError().empty(), "reading closed input fails");
+}
+
+// Recursion stops with an error before it reaches the guard page of a
+// task stack.
+static void testStackOverflow(){
+    Scheduler scheduler(1, 10000, 1 << 20);
+    TaskPtr shallow = scheduler.spawn(compile(deepRecursion(100)));
+    TaskPtr deep = scheduler.spawn(compile(deepRecursion(5000)));
+    scheduler.wait();
+    check(shallow->getError().empty() && shallow->getOutput().size() == 1 && shallow->getOutput()[0] == 4000,
+          "shallow recursion on a task stack");
+    check(deep->getError() == "call stack overflow", "deep recursion on a task stack fails");
+}
+
+// Destroying the scheduler cancels parked and running tasks.
+static void testCancel(){
+    TaskPtr parked;
+    TaskPtr looping;
+    {
+        Scheduler scheduler(2, 100);
+        parked = scheduler.spawn(compile("read a\nprint a\n"));
+        looping = scheduler.spawn(compile("i = 0\nwhile 0 == 0\n    i = i + 1\nend\n"));
+    }
+    check(parked->isFinished() && parked->getError() == "cancelled", "parked task is cancelled");
+    check(looping->isFinished() && looping->getError() == "cancelled", "running task is cancelled");
+}
+
+int main()
+{
+    testPreemption();
+    testParkedReads();
+    testStackOverflow();
+    testCancel();
+    return failures == 0 ? 0 : 1;
+}
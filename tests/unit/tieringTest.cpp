@@ -0,0 +1,67 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "engine.h"
+#include "programContext.h"
+#include "tiering.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static size_t queued(ProgramContext const &program){
+    size_t count = 0;
+    for (map<string, FunPtr>::const_iterator it = program.functions.begin(); it != program.functions.end(); ++it)
+        if (it->second->getTier().state.load() == TierSlot::QUEUED) ++count;
+    return count;
+}
+
+// Queues many defs at once and destroys the manager before its thread
+// can compile them all. No body may be left QUEUED, and a second manager
+// must be able to compile every one of them.
+int main()
+{
+    std::ostringstream source;
+    for (int i = 0; i != 200; ++i) {
+        string name(1, 'a' + i % 26);
+        name += string(1 + i / 26, 'x');
+        source << "def " << name << "(n)\n    s = 0\n    while n > 0\n        s = s + n\n        n = n - 1\n    end\n    return s\nend\n";
+    }
+    source << "print 0\n";
+    std::istringstream in(source.str());
+    CompileOptions options;
+    options.inlineBudget = 0;
+    CompiledProgram program = compileProgram(in, options);
+    if (program->functions.size() != 200) {
+        cout << "expected 200 defs, got " << program->functions.size() << endl;
+        return 1;
+    }
+
+    {
+        TierManager tiering(1, 1);
+        for (map<string, FunPtr>::const_iterator it = program->functions.begin(); it != program->functions.end(); ++it)
+            tiering.enter(*it->second, *program);
+    }
+    int failures = 0;
+    if (queued(*program) != 0) {
+        cout << queued(*program) << " defs left queued" << endl;
+        ++failures;
+    }
+
+    {
+        TierManager tiering(1, 1);
+        for (map<string, FunPtr>::const_iterator it = program->functions.begin(); it != program->functions.end(); ++it)
+            tiering.enter(*it->second, *program);
+        for (int i = 0; i != 10000 && queued(*program) != 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    size_t compiled = 0;
+    for (map<string, FunPtr>::const_iterator it = program->functions.begin(); it != program->functions.end(); ++it)
+        if (it->second->getTier().state.load() == TierSlot::COMPILED) ++compiled;
+    if (compiled != program->functions.size()) {
+        cout << "the second manager compiled " << compiled << " of " << program->functions.size() << " defs" << endl;
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
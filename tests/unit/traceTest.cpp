@@ -0,0 +1,135 @@
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "engine.h"
+#include "interpreter.h"
+#include "trace.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+class Discard: public InputOutput {
+public:
+    bool read(int &){
+        return false;
+    }
+
+    void print(int){}
+};
+
+// Records a recursive program into rings of 16 events, so that most of
+// it is dropped, and checks that every end in the file still has its
+// call and that only a trailing gap leaves calls open.
+int main()
+{
+    std::istringstream source(
+        "def r(n)\n"
+        "    if n == 0\n"
+        "        return 0\n"
+        "    end\n"
+        "    return r(n - 1) + 1\n"
+        "end\n"
+        "i = 0\n"
+        "while i < 2000\n"
+        "    s = r(30)\n"
+        "    i = i + 1\n"
+        "end\n");
+    CompileOptions options;
+    options.inlineBudget = 0;
+    options.loopIdioms = false;
+    CompiledProgram program = compileProgram(source, options);
+
+    char path[] = "/tmp/traceTestXXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        cout << "cannot create a temporary file" << endl;
+        return 1;
+    }
+    close(fd);
+    {
+        TraceRecorder recorder(path, 1, 16);
+        for (int run = 0; run != 2; ++run) {
+            Discard io;
+            ExecutionContext context(*program, io);
+            context.setTrace(recorder.attach());
+            context.run();
+        }
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    TraceHeader header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || header.version != traceVersion) {
+        cout << "bad header" << endl;
+        return 1;
+    }
+
+    size_t open[2] = {0, 0};
+    bool trailing[2] = {false, false};
+    unsigned long long recorded = 0, dropped = 0, lostReturns = 0;
+    TraceChunk chunk;
+    while (in.read(reinterpret_cast<char *>(&chunk), sizeof(chunk))) {
+        if (chunk.type == TraceChunk::NAME) {
+            in.ignore(chunk.size);
+            continue;
+        }
+        if (chunk.buffer > 1 || trailing[chunk.buffer]) {
+            cout << "chunk after the end of buffer " << chunk.buffer << endl;
+            return 1;
+        }
+        if (chunk.type == TraceChunk::DROPPED) {
+            trailing[chunk.buffer] = true;
+            dropped += chunk.size;
+            continue;
+        }
+        for (unsigned i = 0; i != chunk.size; ++i) {
+            TraceEvent event;
+            in.read(reinterpret_cast<char *>(&event), sizeof(event));
+            size_t &depth = open[chunk.buffer];
+            switch (event.getKind()) {
+            case TraceEvent::CALL:
+                ++depth;
+                break;
+            case TraceEvent::RETURN:
+            case TraceEvent::UNWIND:
+                if (!depth) {
+                    cout << "end without a call in buffer " << chunk.buffer << endl;
+                    return 1;
+                }
+                --depth;
+                break;
+            case TraceEvent::DROPPED:
+                if (event.line > depth) {
+                    cout << "gap ends " << event.line << " of " << depth << " open calls" << endl;
+                    return 1;
+                }
+                depth -= event.line;
+                dropped += event.value;
+                lostReturns += event.line;
+                break;
+            default:
+                break;
+            }
+            ++recorded;
+        }
+    }
+    std::remove(path);
+
+    for (int buffer = 0; buffer != 2; ++buffer) {
+        if (open[buffer] && !trailing[buffer]) {
+            cout << open[buffer] << " calls left open in buffer " << buffer << endl;
+            return 1;
+        }
+    }
+    if (!dropped) {
+        cout << "nothing was dropped from " << recorded << " events" << endl;
+        return 1;
+    }
+    cout << recorded << " events recorded, " << dropped << " dropped, ending " << lostReturns << " earlier calls" << endl;
+    return 0;
+}